@@ -1 +1,34 @@
 #pragma once
+
+#include <stddef.h>
+
+#define COLLATZ_API __attribute__((visibility("default")))
+
+/**
+ * Public interface of libcollatz
+ * ---
+ * A workspace owns all the memory used by an encode or decode so
+ * that it stays warm between requests. Workspaces are not shared,
+ * use one per thread; everything else is thread-safe.
+ */
+typedef struct collatz_workspace collatz_workspace_t;
+
+COLLATZ_API collatz_workspace_t* collatz_workspace_new(void);
+COLLATZ_API void collatz_workspace_free(collatz_workspace_t* ws);
+
+/**
+ * Encodes or decodes `in_len` little endian bytes at `in`.
+ * When `in` is limb aligned and `in_len` is a multiple of the limb
+ * size the bytes are used in place without a copy.
+ *
+ * On success `*out` points at the result inside the workspace and
+ * the number of bytes is returned. The result stays valid until the
+ * next call on the same workspace.
+ *
+ * when __SIZE_MAX__ is returned, the input was zero which has
+ * no collatz encoding
+ */
+COLLATZ_API size_t collatz_encode_buffer(collatz_workspace_t* ws,
+  const void* in, size_t in_len, const unsigned char** out);
+COLLATZ_API size_t collatz_decode_buffer(collatz_workspace_t* ws,
+  const void* in, size_t in_len, const unsigned char** out);
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "limb.h"
+
+#define COLLATZ_CACHE_MAGIC "CLZCACHE"
+#define COLLATZ_CACHE_VERSION 1u
+#define COLLATZ_CACHE_MAX_LOG2 32u
+
+/**
+ * Trajectory suffix cache
+ * ---
+ * Holds the parity vector of every value below `bound` so that
+ * the encoder can append the whole tail of a trajectory with word
+ * level bit copies once the working value drops below the bound.
+ *
+ * On disk the cache is laid out so it can be mapped as-is:
+ *   header { magic[8], version, log2_bound, pool_bits }
+ *   offsets[bound + 1]   bit offset of each suffix into the pool
+ *   pool[pool_bits / 64 + 2]
+ * The pool is padded with a zero word so word reads never go OOB.
+ */
+typedef struct collatz_cache {
+  size_t log2_bound;
+  limb_t bound;
+  limb_t pool_bits;
+  const limb_t *offsets;
+  const limb_t *pool;
+
+  // Backing memory, either mapped from a file or heap allocated
+  void *memory;
+  size_t memory_size;
+  bool is_mapped;
+} collatz_cache_t;
+
+collatz_cache_t* build_collatz_cache(size_t log2_bound);
+collatz_cache_t* load_collatz_cache(const char* path);
+void destroy_collatz_cache(collatz_cache_t* cache);
+
+/**
+ * Returns the number of bytes written or __SIZE_MAX__ on failure
+ */
+size_t write_collatz_cache(collatz_cache_t* cache, FILE* file);
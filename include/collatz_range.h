@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "limb.h"
+
+#define RANGE_SIEVE_DEFAULT_LOG2 16u
+#define RANGE_SIEVE_MAX_LOG2 24u
+#define RANGE_BATCH_SIZE 4096u
+#define RANGE_MAX_STEPS (1u << 20)
+
+/**
+ * A 2^k residue sieve
+ * ---
+ * Every n = 2^k m + r follows the same first k parity
+ * steps as r, so after i <= k steps of (3x+1)/2 and x/2 we have
+ * T^i(n) = (3^j n + d_i) / 2^i for constants j and d_i that only
+ * depend on r. If 3^j < 2^i and max(r, 1) (2^i - 3^j) > d_i then
+ * every such n provably drops below itself and can be skipped.
+ *
+ * Only the surviving residues are kept along with the
+ * coefficients of T^k so that the stepping can jump
+ * directly past the first k steps.
+ */
+typedef struct range_sieve {
+  size_t log2_size;
+  size_t length;
+  limb_t *residues;
+  limb_t *pow3;
+  limb_t *offset;
+} range_sieve_t;
+
+typedef struct range_result {
+  limb_t count;
+  limb_t checked;
+  limb_t failed;
+  bool has_failed;
+  double seconds;
+} range_result_t;
+
+range_sieve_t* new_range_sieve(size_t log2_size);
+void destroy_range_sieve(range_sieve_t* sieve);
+
+/**
+ * Checks that every n in [start, end) eventually drops below n,
+ * which together with all values below start being verified
+ * implies that every value in the range reaches 1.
+ * Survivors are stepped in parallel batches of `range_batch_size`
+ * survivors, RANGE_BATCH_SIZE unless tuned.
+ *
+ * If some value fails to drop within RANGE_MAX_STEPS the smallest
+ * such value is reported in `failed`.
+ */
+range_result_t verify_range(range_sieve_t* sieve, limb_t start, limb_t end);
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SERVE_QUEUE_CAPACITY 256u
+#define SERVE_QUEUE_MAX_BYTES ((uint64_t) 1u << 28)
+#define SERVE_MAX_REQUEST_LENGTH ((uint64_t) 1u << 24)
+#define SERVE_MAX_PENDING_BYTES ((uint64_t) 1u << 26)
+#define SERVE_LISTEN_BACKLOG 64
+
+#define SERVE_OP_ENCODE 'e'
+#define SERVE_OP_DECODE 'd'
+
+#define SERVE_STATUS_OK 0u
+#define SERVE_STATUS_ZERO 1u
+#define SERVE_STATUS_BAD_OP 2u
+
+/**
+ * Framing
+ * ---
+ * Every request is a header followed by `length` payload bytes, and
+ * every response echoes the request id followed by its own payload.
+ * Integers are little endian. Requests may be pipelined and responses
+ * come back in completion order, so clients match them up by id.
+ */
+typedef struct serve_request_header {
+  uint32_t op;
+  uint32_t reserved;
+  uint64_t id;
+  uint64_t length;
+} serve_request_header_t;
+
+typedef struct serve_response_header {
+  uint32_t status;
+  uint32_t reserved;
+  uint64_t id;
+  uint64_t length;
+} serve_response_header_t;
+
+typedef struct serve_pool serve_pool_t;
+
+/**
+ * Worker pool with one warm collatz workspace per thread.
+ * Jobs go through a queue bounded by SERVE_QUEUE_CAPACITY jobs and
+ * SERVE_QUEUE_MAX_BYTES of payload so a connection that outpaces
+ * the workers stops being read, which pushes back on the client
+ * through the socket buffers. Requests over SERVE_MAX_REQUEST_LENGTH
+ * bytes close the connection.
+ */
+serve_pool_t* new_serve_pool(size_t num_threads);
+void destroy_serve_pool(serve_pool_t* pool);
+
+/**
+ * Reads requests from in_fd until eof and writes responses
+ * to out_fd from a writer thread of its own, so workers never block
+ * on a slow client. Reading pauses while more than
+ * SERVE_MAX_PENDING_BYTES of responses wait to be written. Returns
+ * once every response has been written. The file descriptors are
+ * not closed.
+ */
+void serve_connection(serve_pool_t* pool, int in_fd, int out_fd);
+
+/**
+ * Accepts connections on a unix domain socket at `path`, serving
+ * each one on its own reader thread. A socket left at `path` is
+ * replaced but any other file fails with EADDRINUSE. Only returns
+ * on failure, with errno set.
+ */
+bool serve_unix_socket(serve_pool_t* pool, const char* path);
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stddef.h>
+#include "limb_dlist.h"
+
+#define STATS_BATCH_SIZE 65536u
+
+/**
+ * Trajectory statistics without a parity vector
+ * ---
+ * Steps the same map as the encoder, x / 2 for even and (3x + 1) / 2
+ * for odd x, but only keeps counters so memory is bounded by the
+ * working value. A value n has a parity vector of steps + 1 bits of
+ * which odd_steps + 1 are set.
+ */
+typedef struct collatz_stats {
+  // Steps until the value reaches 1
+  limb_t steps;
+  // Steps that were (3x + 1) / 2
+  limb_t odd_steps;
+  // Largest bit length along the trajectory, including n itself
+  limb_t peak_bits;
+  // First step at which the value is below n, 0 if it never is
+  limb_t drop_step;
+} collatz_stats_t;
+
+/**
+ * Values are stepped in 128 bits and only fall back to limb lists
+ * once a trajectory outgrows them
+ */
+collatz_stats_t collatz_stats_value(limb_t n);
+
+/**
+ * Every values[i] in parallel. Use batches of STATS_BATCH_SIZE or so
+ * to keep the memory of `out` bounded.
+ */
+void collatz_stats_batch(const limb_t* values, size_t count, collatz_stats_t* out);
+
+/**
+ * Statistics of a value stored in the plain 2^64 radix, as read from
+ * a file. The value is consumed like collatz_encode_pow2 does.
+ */
+collatz_stats_t collatz_stats_pow2(limb_dlist_t* ll);
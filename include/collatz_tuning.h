@@ -0,0 +1,79 @@
+#pragma once
+
+#include <stdio.h>
+#include <stddef.h>
+
+#define TUNING_PATH_ENV "COLLATZ_TUNING"
+#define TUNING_DEFAULT_FILE ".collatz_tuning"
+#define TUNING_MAX_LINE 256u
+
+/**
+ * Per host tuning profile
+ * ---
+ * The knobs that used to be compile time constants. The profile is
+ * loaded once per process from the file named by $COLLATZ_TUNING or
+ * else ~/.collatz_tuning, by the CLI at startup and by libcollatz
+ * when the first workspace is created. Without a profile the
+ * compiled in defaults are used.
+ * `collatz tune` measures each knob on the current host and writes
+ * the profile.
+ *
+ * The file holds one `key=value` per line, `#` starts a comment and
+ * keys that are not present keep their default.
+ */
+typedef struct collatz_tuning {
+  // OpenMP threads for range, cache and verify, 0 for the runtime default
+  size_t threads;
+  // Container size of a new limb list, a power of two (LL_INITIAL_SIZE)
+  size_t initial_limbs;
+  // Containers of at least this many bytes are huge page mappings
+  size_t huge_page_threshold;
+  // Largest size class handled by the fixed kernels, 0 disables them
+  size_t fixed_max_limbs;
+  // Steps a fixed kernel takes before handing back to the caller
+  size_t fixed_chunk_steps;
+  // Sieve survivors per parallel work item of verify_range
+  size_t range_batch_size;
+  // Parity bits per parallel segment of fingerprint_parity_vector
+  size_t verify_segment_bits;
+} collatz_tuning_t;
+
+void default_collatz_tuning(collatz_tuning_t* tuning);
+
+/**
+ * The active profile. Thread safe as long as nothing sets it.
+ */
+const collatz_tuning_t* get_collatz_tuning();
+
+/**
+ * Replaces the active profile. `initial_limbs` is raised to at least
+ * LL_INITIAL_SIZE since callers rely on that much room in a new list.
+ * Not thread safe, call it before starting any work.
+ */
+void set_collatz_tuning(const collatz_tuning_t* tuning);
+
+/**
+ * Makes the profile at collatz_tuning_path active, the first time
+ * it is called. A malformed profile leaves the defaults in place.
+ * Thread safe, every caller returns after the profile is loaded.
+ */
+void load_collatz_tuning();
+
+/**
+ * Parses a profile on top of the values already in `tuning`.
+ * Returns the number of keys read or __SIZE_MAX__ if the file is
+ * malformed or a value is out of range, leaving `tuning` untouched.
+ */
+size_t read_collatz_tuning(collatz_tuning_t* tuning, FILE *file);
+size_t write_collatz_tuning(const collatz_tuning_t* tuning, FILE *file);
+
+/**
+ * Where the profile is loaded from, NULL if neither
+ * $COLLATZ_TUNING nor $HOME are set
+ */
+const char* collatz_tuning_path(char* path, size_t path_size);
+
+/**
+ * OpenMP thread count to use for a parallel region
+ */
+int tuned_num_threads();
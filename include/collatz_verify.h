@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "limb_dlist.h"
+
+#define VERIFY_MAX_PRIMES 8u
+#define VERIFY_DEFAULT_PRIMES 2u
+#define VERIFY_SEGMENT_BITS ((size_t) 1u << 20)
+
+/**
+ * Modular fingerprints
+ * ---
+ * A value is summarized by its residues modulo a few 61-bit primes.
+ * The residues of a decoded value can be computed straight from its
+ * parity vector by applying x -> 2x and x -> (2x - 1) / 3 mod p, so a
+ * round trip can be checked without running collatz_decode. Two
+ * different values collide with probability below 2^-60 per prime.
+ */
+typedef struct fingerprint {
+  size_t num_primes;
+  limb_t residues[VERIFY_MAX_PRIMES];
+} fingerprint_t;
+
+/**
+ * Fingerprint of a value stored in the plain 2^64 radix
+ */
+void fingerprint_value(fingerprint_t* fp, limb_dlist_t* ll, size_t num_primes);
+
+/**
+ * Fingerprint of the value a parity vector decodes to. Segments of
+ * `verify_segment_bits` bits, VERIFY_SEGMENT_BITS unless tuned, are
+ * reduced to affine maps in parallel and then composed in order.
+ */
+void fingerprint_parity_vector(fingerprint_t* fp, limb_dlist_t* ll, size_t num_primes);
+
+bool is_eq_fingerprint(fingerprint_t* a, fingerprint_t* b);
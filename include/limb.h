@@ -2,13 +2,43 @@
 
 typedef unsigned long long limb_t;
 
+// Double width limb for carries and products. __extension__ keeps
+// -Wpedantic quiet about the non-standard type.
+__extension__ typedef unsigned __int128 wide_limb_t;
+
 // Assume: Bit length of a byte == 8;
 // It is a hard requirement that we are working with bytes
 // with a standard bit length  of 8
 #define LIMB_CONTAINER_BIT_LENGTH (sizeof(limb_t) * 8u)
 #define LIMB_BIT_LENGTH (LIMB_CONTAINER_BIT_LENGTH - 1u)
-#define LIMB_BASE (((limb_t) 1u << LIMB_BIT_LENGTH) - 2u)
+
+// The custom radix is the largest multiple of 2^a 3^b below 2^63 so
+// that x / 2^k and x / 3^k for k up to a and b are a single pass.
+// The default a = b = 1 gives 2^63 - 2. Override at build time with
+// -DLIMB_RADIX_TWOS=a -DLIMB_RADIX_THREES=b.
+#ifndef LIMB_RADIX_TWOS
+#define LIMB_RADIX_TWOS 1u
+#endif
+#ifndef LIMB_RADIX_THREES
+#define LIMB_RADIX_THREES 1u
+#endif
+#define LIMB_RADIX_MAX_POWER 8u
+
+_Static_assert(LIMB_RADIX_TWOS >= 1u && LIMB_RADIX_TWOS <= LIMB_RADIX_MAX_POWER,
+  "LIMB_RADIX_TWOS must be between 1 and LIMB_RADIX_MAX_POWER");
+_Static_assert(LIMB_RADIX_THREES >= 1u && LIMB_RADIX_THREES <= LIMB_RADIX_MAX_POWER,
+  "LIMB_RADIX_THREES must be between 1 and LIMB_RADIX_MAX_POWER");
+
+#define LIMB_POW2(K) ((limb_t) 1u << (K))
+#define LIMB_POW3(K) ((limb_t) ((K) >= 1u ? 3u : 1u) * ((K) >= 2u ? 3u : 1u) \
+  * ((K) >= 3u ? 3u : 1u) * ((K) >= 4u ? 3u : 1u) * ((K) >= 5u ? 3u : 1u) \
+  * ((K) >= 6u ? 3u : 1u) * ((K) >= 7u ? 3u : 1u) * ((K) >= 8u ? 3u : 1u))
+
+#define LIMB_RADIX_SMOOTH (LIMB_POW2(LIMB_RADIX_TWOS) * LIMB_POW3(LIMB_RADIX_THREES))
+#define LIMB_BASE (LIMB_RADIX_SMOOTH * ((((limb_t) 1u << LIMB_BIT_LENGTH) - 1u) / LIMB_RADIX_SMOOTH))
 #define LIMB_MAX_VAL (LIMB_BASE - 1u)
-#define LIMB_DIVIDE_BY_TWO (LIMB_BASE / 2u)
-#define LIMB_DIVIDE_BY_THREE (LIMB_BASE / 3u)
+#define LIMB_DIVIDE_BY_POW2(K) (LIMB_BASE / LIMB_POW2(K))
+#define LIMB_DIVIDE_BY_POW3(K) (LIMB_BASE / LIMB_POW3(K))
+#define LIMB_DIVIDE_BY_TWO LIMB_DIVIDE_BY_POW2(1u)
+#define LIMB_DIVIDE_BY_THREE LIMB_DIVIDE_BY_POW3(1u)
 
@@ -1,6 +1,46 @@
 #pragma once
 
 #include "limb_dlist.h"
+#include "collatz_cache.h"
+#include "limb_stream.h"
+
+/**
+ * Optional extras for the encoders, any field may be NULL
+ * ---
+ * cache: once the working value drops below the cache bound the
+ *   rest of the parity vector is copied out of the cache instead
+ *   of being stepped
+ * stream: finished limbs of the parity vector are handed to the
+ *   stream while the rest is still being computed
+ */
+typedef struct collatz_encoder {
+  const collatz_cache_t* cache;
+  limb_stream_t* stream;
+} collatz_encoder_t;
 
 limb_dlist_t* collatz_encode(limb_dlist_t* ll);
+limb_dlist_t* collatz_encode_with(limb_dlist_t* ll, const collatz_encoder_t* encoder);
+
+/**
+ * Same as collatz_encode_with but writes the parity vector into
+ * `result`, replacing its contents, so a caller that encodes over
+ * and over can keep reusing one container
+ */
+void collatz_encode_into(limb_dlist_t* result, limb_dlist_t* ll, const collatz_encoder_t* encoder);
+
 limb_dlist_t* collatz_decode(limb_dlist_t* ll);
+
+/**
+ * Encodes a number given in the plain 2^64 radix without
+ * converting it into the custom radix first. Produces the same
+ * parity vector as collatz_encode. The encoder may be NULL.
+ */
+limb_dlist_t* collatz_encode_pow2(limb_dlist_t* ll, const collatz_encoder_t* encoder);
+void collatz_encode_pow2_into(limb_dlist_t* result, limb_dlist_t* ll, const collatz_encoder_t* encoder);
+
+/**
+ * Decodes into the plain 2^64 radix so the result can be written
+ * out without converting it back from the custom radix.
+ */
+limb_dlist_t* collatz_decode_pow2(limb_dlist_t* ll);
+void collatz_decode_pow2_into(limb_dlist_t* result, limb_dlist_t* ll);
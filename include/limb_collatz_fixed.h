@@ -0,0 +1,34 @@
+#pragma once
+
+#include "limb_dlist.h"
+
+#define FIXED_MAX_LIMBS 16u
+#define FIXED_CHUNK_STEPS 256u
+
+/**
+ * Size class specialized kernels
+ * ---
+ * Values that fit in 1, 2, 4, 8 or 16 limbs are stepped by kernels
+ * generated for that exact length, which keep the limbs in registers
+ * for a whole chunk of steps and skip the
+ * canonicalize and overflow bookkeeping of the generic kernels.
+ * A kernel hands back to the caller when its chunk is done or when
+ * the value may outgrow its size class, so the caller can pick a
+ * class again. The largest class used and the chunk length are the
+ * `fixed_max_limbs` and `fixed_chunk_steps` tuning knobs, which
+ * default to FIXED_MAX_LIMBS and FIXED_CHUNK_STEPS.
+ *
+ * Both return the number of steps taken, 0 when ll does not fit a
+ * size class and the generic path has to take the next step.
+ */
+
+/**
+ * Encode steps stop early once the value is a single limb below
+ * `stop_below`, which is 2 to stop at 1 or the cache bound
+ */
+size_t collatz_encode_fixed(limb_dlist_t* ll, limb_dlist_t* result, size_t bit_index, limb_t stop_below);
+
+/**
+ * Decode steps consume parity bits bit_index, bit_index - 1, ... 0
+ */
+size_t collatz_decode_fixed(limb_dlist_t* result, limb_dlist_t* ll, size_t bit_index);
@@ -5,6 +5,9 @@
 #include "limb.h"
 
 #define LL_INITIAL_SIZE 16
+#define LL_ALIGNMENT 64u
+#define LL_HUGE_PAGE_SIZE ((size_t) 2u << 20)
+#define LL_HUGE_PAGE_THRESHOLD LL_HUGE_PAGE_SIZE
 #define LL_INDEX(LL, I) (LL)->handle[I]
 #define LL_HEAD(LL) (LL)->handle[0]
 #define LL_TAIL(LL) (LL)->handle[(LL)->length - 1u]
@@ -13,12 +16,30 @@ typedef struct limb_dlist {
   size_t length;
   size_t container_size;
   limb_t *handle;
+  // Whether the container is a mapping, fixed when it is allocated
+  bool is_huge;
 } limb_dlist_t;
 
 
-limb_t* new_limb_handle(size_t container_size);
+/**
+ * Limb memory is always LL_ALIGNMENT aligned. Containers of at least
+ * LL_HUGE_PAGE_THRESHOLD bytes are mapped directly, backed by
+ * transparent huge pages and grown in place with mremap so that
+ * growing a large number never copies it.
+ * LL_INITIAL_SIZE and LL_HUGE_PAGE_THRESHOLD are the defaults of the
+ * `initial_limbs` and `huge_page_threshold` tuning knobs.
+ */
+bool is_huge_container(size_t container_size);
+limb_t* new_limb_handle(size_t container_size, bool is_huge);
+void destroy_limb_handle(limb_t* handle, size_t container_size, bool is_huge);
 limb_dlist_t* new_limb_list();
 
+/**
+ * Called by set_collatz_tuning. Lists that are already alive keep
+ * the kind of memory they were allocated with.
+ */
+void set_limb_list_tuning(size_t initial_limbs, size_t huge_page_threshold);
+
 /**
  * Utilities to insert and remove at tail
  * ---
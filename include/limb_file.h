@@ -3,6 +3,10 @@
 #include <stdio.h>
 #include "limb_dlist.h"
 
+// Files are read and written in blocks of 1 MiB
+#define FILE_BLOCK_LIMBS ((size_t) 1u << 17)
+#define FILE_BLOCK_BYTES (FILE_BLOCK_LIMBS * sizeof(limb_t))
+
 /**
  * Reads or write a file from limb list to file.
  * We expect the caller to properly close and destroy
@@ -11,6 +15,14 @@
  * when __SIZE_MAX__ is returned, it means a read or
  * write has failed. otherwise we return the number of
  * bytes read or written
+ *
+ * Neither seeks, so pipes such as stdin and stdout work.
  */
 size_t read_file(limb_dlist_t* ll, FILE *file);
 size_t write_file(limb_dlist_t* ll, FILE *file);
+
+/**
+ * Same as write_file but skips the first `start` limbs,
+ * for when they have already been written
+ */
+size_t write_file_from(limb_dlist_t* ll, size_t start, FILE *file);
@@ -1,6 +1,13 @@
 #pragma once
 
 #include "limb_dlist.h"
+#include "limb_stream.h"
 
 void to_radix_pow2(limb_dlist_t* dest, limb_dlist_t* src);
+
+/**
+ * Bits of dest are finalized from least to most significant so
+ * finished limbs are handed to the stream as they are produced
+ */
+void to_radix_pow2_streamed(limb_dlist_t* dest, limb_dlist_t* src, limb_stream_t* stream);
 void to_radix_custom(limb_dlist_t* dest, limb_dlist_t* src);
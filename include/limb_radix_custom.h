@@ -2,6 +2,29 @@
 
 #include "limb_dlist.h"
 
+/**
+ * Number of whole list sweeps done by the kernels on this thread,
+ * bench divides it by the bits encoded. Only counted in builds with
+ * COLLATZ_COUNT_PASSES, such as `make bench-radix`, so the kernels
+ * of a normal build do not touch thread local storage.
+ */
+#ifdef COLLATZ_COUNT_PASSES
+extern _Thread_local size_t custom_radix_passes;
+#define COUNT_RADIX_PASSES(N) (custom_radix_passes += (N))
+
+static inline size_t take_custom_radix_passes() {
+  size_t passes = custom_radix_passes;
+  custom_radix_passes = 0;
+  return passes;
+}
+#else
+#define COUNT_RADIX_PASSES(N) ((void) 0)
+
+static inline size_t take_custom_radix_passes() {
+  return 0;
+}
+#endif
+
 void add(limb_dlist_t* a, limb_dlist_t* b);
 void plus_one(limb_dlist_t* ll);
 void minus_one(limb_dlist_t* ll);
@@ -12,3 +35,33 @@ void multiply_by_three(limb_dlist_t* ll);
 void multiply_by_three_and_increment(limb_dlist_t* ll);
 void divide_by_three_optim(limb_dlist_t* ll, limb_dlist_t* buffer);
 void fused_increment_divide_by_two(limb_dlist_t* ll);
+
+/**
+ * Single sweep collatz steps, in place with no scratch list
+ * ---
+ * fused_multiply_by_three_increment_halve expects x to be odd and
+ * computes (3x + 1) / 2. fused_double_decrement_divide_by_three
+ * expects 2x - 1 to be divisible by 3 and computes (2x - 1) / 3.
+ */
+void fused_multiply_by_three_increment_halve(limb_dlist_t* ll);
+void fused_double_decrement_divide_by_three(limb_dlist_t* ll);
+
+/**
+ * Runs of steps in a single pass
+ * ---
+ * The base is divisible by 2^a and 3^b (LIMB_RADIX_TWOS and
+ * LIMB_RADIX_THREES) so for k up to those, x / 2^k and x / 3^k are
+ * limb local and x * 2^k carries at most 2^k.
+ * fused_odd_steps applies k steps of (3x + 1) / 2, which is
+ * 3^k floor(x / 2^k) + 3^k - 1 when x + 1 is divisible by 2^k, and
+ * fused_inverse_odd_steps undoes them with 2^k floor(x / 3^k) + 2^k - 1.
+ * even_run_length and odd_run_length give the longest run the next
+ * step starts that a single pass can take.
+ */
+void right_shift_by(limb_dlist_t* ll, size_t k);
+void divide_by_three_pow(limb_dlist_t* ll, size_t k);
+void left_shift_by(limb_dlist_t* ll, size_t k);
+void fused_odd_steps(limb_dlist_t* ll, size_t k);
+void fused_inverse_odd_steps(limb_dlist_t* ll, size_t k);
+size_t even_run_length(limb_dlist_t* ll);
+size_t odd_run_length(limb_dlist_t* ll);
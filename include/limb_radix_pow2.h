@@ -5,3 +5,29 @@
 void set_ith_bit(limb_dlist_t* ll, size_t bit_index);
 limb_t get_ith_bit(limb_dlist_t* ll, size_t bit_index);
 size_t get_bit_length(limb_dlist_t* ll);
+
+/**
+ * ORs `bit_length` bits of `bits` starting at `bit_offset` into
+ * ll starting at `bit_index` using word sized copies.
+ * `bits` must be readable one word past the last copied bit.
+ */
+void append_bits(limb_dlist_t* ll, size_t bit_index, const limb_t* bits, size_t bit_offset, size_t bit_length);
+
+/**
+ * Arithmetic in the plain 2^64 radix
+ * ---
+ * Encoding only ever needs x / 2^k and (3x + 1) / 2 which are a
+ * word shift and an add with carry in this radix, so the encoder
+ * can skip the conversion into the custom radix entirely.
+ */
+size_t pow2_count_trailing_zeros(limb_dlist_t* ll);
+void pow2_right_shift_by(limb_dlist_t* ll, size_t bits);
+void pow2_fused_multiply_by_three_increment_halve(limb_dlist_t* ll);
+
+/**
+ * Decoding only ever needs x * 2^k and (2x - 1) / 3. The division
+ * is always exact so it is a multiplication by the inverse of 3
+ * modulo 2^64 with a borrow chain instead of a remainder search.
+ */
+void pow2_left_shift_by(limb_dlist_t* ll, size_t bits);
+void pow2_fused_double_decrement_divide_by_three(limb_dlist_t* ll);
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include "limb_dlist.h"
+
+#define STREAM_BLOCK_LIMBS ((size_t) 1u << 16)
+#define STREAM_RING_BLOCKS 8u
+#define STREAM_BLOCK_BITS (STREAM_BLOCK_LIMBS * LIMB_CONTAINER_BIT_LENGTH)
+
+/**
+ * Overlaps writing an output with computing it
+ * ---
+ * The encoders and to_radix_pow2 finalize their output from the
+ * least significant limb up, so finished limbs are copied into a
+ * bounded ring of blocks that a dedicated I/O thread writes out
+ * while the rest of the output is still being computed.
+ */
+typedef struct limb_stream {
+  FILE *file;
+  pthread_t thread;
+
+  // Limbs of the output already handed to the I/O thread
+  size_t emitted;
+  // Bit index at which the next full block will be finished
+  size_t next_flush_bit;
+
+  limb_t *blocks;
+  bool blocks_are_huge;
+  size_t block_lengths[STREAM_RING_BLOCKS];
+  size_t head;
+  size_t length;
+  bool is_done;
+  bool has_failed;
+  size_t bytes_write;
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
+} limb_stream_t;
+
+limb_stream_t* new_limb_stream(FILE *file);
+void stream_finished_limbs(limb_stream_t* stream, limb_dlist_t* ll, size_t finished_limbs);
+
+/**
+ * Writes out the rest of ll the same way write_file does, waits for
+ * the I/O thread and destroys the stream. Returns the total number of
+ * bytes written or __SIZE_MAX__ if any write failed.
+ */
+size_t finish_limb_stream(limb_stream_t* stream, limb_dlist_t* ll);
+
+/**
+ * Hands every whole block of limbs below `finished_bit` to the I/O
+ * thread. Cheap to call often, it returns immediately until a whole
+ * block is finished and blocks while the ring is full.
+ * A NULL stream does nothing.
+ */
+static inline void stream_finished_bits(limb_stream_t* stream, limb_dlist_t* ll, size_t finished_bit) {
+  if (stream == NULL || finished_bit < stream->next_flush_bit) return;
+  stream_finished_limbs(stream, ll, finished_bit / LIMB_CONTAINER_BIT_LENGTH);
+}
@@ -1,3 +1,4 @@
+#include "collatz.h"
 #include "limb.h"
 #include "limb_file.h"
 #include "limb_dlist.h"
@@ -5,17 +6,38 @@
 #include "limb_radix_common.h"
 #include "limb_radix_convert.h"
 #include "limb_radix_custom.h"
+#include "limb_radix_pow2.h"
+#include "limb_stream.h"
+#include "limb_collatz_fixed.h"
+#include "collatz_range.h"
+#include "collatz_cache.h"
+#include "collatz_serve.h"
+#include "collatz_verify.h"
+#include "collatz_tuning.h"
+#include "collatz_stats.h"
 
 #include <err.h>
+#include <errno.h>
+#include <limits.h>
+#include <omp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
 #include <time.h>
+#include <unistd.h>
 
 #define DEFER(...) for (int _i = 1; _i; _i = 0, __VA_ARGS__)
 
-#define LOG_EXECUTION_TIME(STR) for( \
+#define LOG_EXECUTION_TIME_TO(FILE, STR) for( \
   clock_t _start = clock(), _end = 0; \
   _end == 0; \
   _end = clock(), \
-  printf((STR), (double) (_end - _start) / CLOCKS_PER_SEC))
+  fprintf((FILE), (STR), (double) (_end - _start) / CLOCKS_PER_SEC))
+
+#define LOG_EXECUTION_TIME(STR) LOG_EXECUTION_TIME_TO(stdout, STR)
 
 
 int test() {
@@ -173,141 +195,1602 @@ int test_range2() {
 }
 
 
-void test_limb_list() {
-  limb_dlist_t* ll = new_limb_list();
-  printf("empty: ");
-  print_limb_list(ll);
-  
-  for (size_t i = 0; i < 10; i++) {
-    insert_at_tail(ll, (limb_t) i);
-  }
-  
-  printf("insert 0-9 at tail: ");
-  print_limb_list(ll);
-  
+int test_sieve() {
+  range_sieve_t* sieve = new_range_sieve(12);
+  limb_t size = (limb_t) 1u << sieve->log2_size;
+  size_t next_survivor = 0;
 
-  grow_limb_list(ll);
-  printf("grow list: ");
-  print_limb_list(ll);
-  
-  for (size_t i = 0; i < 6; i++) {
-    insert_at_tail(ll, (limb_t) i);
+  LOG_EXECUTION_TIME("Passed tests: %f seconds\n") {
+    for (limb_t r = 0; r < size; r++) {
+      if (next_survivor < sieve->length && sieve->residues[next_survivor] == r) {
+        next_survivor++;
+        continue;
+      }
+
+      // Every skipped residue class must drop below its start within k steps
+      for (limb_t m = 0; m < 256; m++) {
+        limb_t n = m * size + r;
+        if (n <= 1u) continue;
+
+        limb_t x = n;
+        bool dropped = false;
+        for (size_t i = 0; i < sieve->log2_size && !dropped; i++) {
+          x = (x % 2u == 0) ? x / 2u : x + x / 2u + 1u;
+          dropped = x < n;
+        }
+
+        if (!dropped) {
+          printf("main: skipped residue: %llu  input: %llu\n", r, n);
+          errx(EXIT_FAILURE, "err: sieve skipped a non-dropping residue");
+        }
+      }
+    }
+
+    range_result_t result = verify_range(sieve, 1, 1u << 20);
+    if (result.has_failed) {
+      printf("main: failed: %llu\n", result.failed);
+      errx(EXIT_FAILURE, "err: range verification failed");
+    }
+
+    destroy_range_sieve(sieve);
   }
-  printf("insert 0-6 at tail: ");
-  print_limb_list(ll);
-  
-  for (size_t i = 0; i < 4; i++) {
-    remove_at_tail(ll);
+
+  return 0;
+}
+
+
+int test_cache() {
+  collatz_cache_t* cache = build_collatz_cache(12);
+  limb_dlist_t* ll = new_limb_list();
+  limb_dlist_t* input = new_limb_list();
+  insert_at_tail(ll, 1);
+
+  LOG_EXECUTION_TIME("Passed tests: %f seconds\n") {
+    for (size_t i = 0; i < 256*256; i++) {
+
+      copy_limb_list(input, ll);
+      limb_dlist_t* collatz = collatz_encode(input);
+      copy_limb_list(input, ll);
+      collatz_encoder_t encoder = { cache, NULL };
+      limb_dlist_t* cached = collatz_encode_with(input, &encoder);
+
+      if (!is_eq(collatz, cached)) {
+        printf("main: input: ");
+        print_limb_list(ll);
+        printf("main: collatz: ");
+        print_limb_list(collatz);
+        printf("main: cached: ");
+        print_limb_list(cached);
+        printf("\n");
+        errx(EXIT_FAILURE, "err: cached collatz mismatch");
+      }
+
+      destroy_limb_list(collatz);
+      destroy_limb_list(cached);
+
+      plus_one(ll);
+    }
+
+    // A file whose offsets run backwards must not be mapped
+    char path[] = "/tmp/collatz_cache_XXXXXX";
+    int fd = mkstemp(path);
+    FILE *file = fd >= 0 ? fdopen(fd, "w+b") : NULL;
+    if (file == NULL) err(EXIT_FAILURE, "err: failed to create temporary cache");
+
+    write_collatz_cache(cache, file);
+    fflush(file);
+    collatz_cache_t* loaded = load_collatz_cache(path);
+    if (loaded == NULL) errx(EXIT_FAILURE, "err: valid cache rejected");
+    destroy_collatz_cache(loaded);
+
+    limb_t offset = cache->offsets[2] + 1u;
+    fseek(file, (long) ((const char*) &cache->offsets[1] - (const char*) cache->memory), SEEK_SET);
+    fwrite(&offset, sizeof(offset), 1, file);
+    fclose(file);
+    loaded = load_collatz_cache(path);
+    unlink(path);
+    if (loaded != NULL) errx(EXIT_FAILURE, "err: corrupted cache accepted");
+
+    destroy_limb_list(ll);
+    destroy_limb_list(input);
+    destroy_collatz_cache(cache);
   }
-  
-  printf("remove 3-6 at tail: ");
-  print_limb_list(ll);
-  
-  destroy_limb_list(ll);
+
+  return 0;
 }
 
-void print_usage(char* prog_name) {
-  fprintf(stderr, "Usage: %s <encode|decode> <input_file> <output_file>\n", prog_name);
-  fprintf(stderr, "Usage: %s <test>\n", prog_name);
+
+int test_buffer() {
+  collatz_workspace_t* ws = collatz_workspace_new();
+  limb_t storage[64];
+  unsigned char* bytes = (unsigned char*) storage;
+  unsigned char input[64];
+
+  LOG_EXECUTION_TIME("Passed tests: %f seconds\n") {
+    for (size_t i = 0; i < 256*64; i++) {
+      // Alternate between aligned whole limbs and unaligned odd lengths
+      size_t offset = i % 2u;
+      size_t length = 1u + i % (sizeof(input) - 1u);
+
+      for (size_t j = 0; j < length; j++) {
+        input[j] = (unsigned char) ((i * 2654435761u) >> (j % 24u));
+      }
+      // Most significant byte must be non-zero to round trip exactly
+      input[length - 1] |= 1u;
+      memcpy(bytes + offset, input, length);
+
+      const unsigned char* encoded = NULL;
+      size_t encoded_len = collatz_encode_buffer(ws, bytes + offset, length, &encoded);
+      if (encoded_len == __SIZE_MAX__ || encoded_len > sizeof(storage)) {
+        printf("main: length: %zu  encoded: %zu\n", length, encoded_len);
+        errx(EXIT_FAILURE, "err: buffer encode failed");
+      }
+      // The caller's bytes are only ever read
+      if (memcmp(bytes + offset, input, length) != 0) {
+        errx(EXIT_FAILURE, "err: buffer encode wrote to its input");
+      }
+      // Encoded bytes live in the workspace so copy them out before decoding
+      memcpy(storage, encoded, encoded_len);
+
+      const unsigned char* decoded;
+      size_t decoded_len = collatz_decode_buffer(ws, storage, encoded_len, &decoded);
+
+      if (decoded_len != length || memcmp(decoded, input, length) != 0) {
+        printf("main: length: %zu  encoded: %zu  decoded: %zu\n", length, encoded_len, decoded_len);
+        errx(EXIT_FAILURE, "err: buffer round trip mismatch");
+      }
+    }
+
+    collatz_workspace_free(ws);
+  }
+
+  return 0;
 }
 
 
-void encode_main(char* argv[]) {
+typedef struct test_serve_args {
+  serve_pool_t* pool;
+  int fd;
+} test_serve_args_t;
 
-  FILE *in_file = fopen(argv[2], "rb");
-  if (in_file == NULL) {
-    errx(EXIT_FAILURE, "err: failed to open file in read binary mode");
+// Socket reads and writes may be short so both loop until done
+bool test_read_full(int fd, void* buffer, size_t length) {
+  unsigned char* bytes = (unsigned char*) buffer;
+  while (length != 0) {
+    ssize_t n = read(fd, bytes, length);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    bytes += n;
+    length -= (size_t) n;
+  }
+  return true;
+}
+
+bool test_write_full(int fd, const void* buffer, size_t length) {
+  const unsigned char* bytes = (const unsigned char*) buffer;
+  while (length != 0) {
+    ssize_t n = write(fd, bytes, length);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    bytes += n;
+    length -= (size_t) n;
   }
-  printf("file: open input: %s\n", argv[2]);
+  return true;
+}
 
+void* test_serve_connection(void* arg) {
+  test_serve_args_t* args = (test_serve_args_t*) arg;
+  serve_connection(args->pool, args->fd, args->fd);
+  shutdown(args->fd, SHUT_WR);
+  return NULL;
+}
 
-  // Erase the file
-  FILE *out_file = fopen(argv[3], "wb");
-  if (out_file == NULL) {
-    fclose(in_file);
-    errx(EXIT_FAILURE, "err: failed to open file in write binary mode");
+int test_serve() {
+  int fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+    errx(EXIT_FAILURE, "err: failed to create socket pair");
   }
-  fclose(out_file);
 
-  // Re-open in append only
-  out_file = fopen(argv[3], "ab");
-  if (out_file == NULL) {
-    fclose(in_file);
-    errx(EXIT_FAILURE, "err: failed to open file in append binary mode");
+  int stalled_fds[2];
+  if (socketpair(AF_UNIX, SOCK_STREAM, 0, stalled_fds) != 0) {
+    errx(EXIT_FAILURE, "err: failed to create socket pair");
   }
-  printf("file: open output: %s\n", argv[3]);
 
+  serve_pool_t* pool = new_serve_pool(4);
+  test_serve_args_t args = { pool, fds[1] };
+  test_serve_args_t stalled_args = { pool, stalled_fds[1] };
+  pthread_t thread;
+  pthread_t stalled_thread;
+  pthread_create(&stalled_thread, NULL, test_serve_connection, &stalled_args);
 
-  DEFER(fclose(in_file), fclose(out_file)) {
-    limb_dlist_t* ll = new_limb_list();
+  const size_t num_requests = 64;
+  limb_t payload[4];
+  size_t encoded_len[64] = {0};
 
-    size_t bytes_read = read_file(ll, in_file);
-    if (bytes_read == __SIZE_MAX__) {
-      printf("err: failed to read from file\n");
-      destroy_limb_list(ll);
-      break;
+  LOG_EXECUTION_TIME("Passed tests: %f seconds\n") {
+    // A client that never reads its responses must not hold up
+    // the workers serving everyone else
+    const size_t num_stalled = 16384;
+    for (size_t i = 0; i < num_stalled; i++) {
+      payload[0] = i + 1u;
+      serve_request_header_t header = { SERVE_OP_ENCODE, 0, i, sizeof(limb_t) };
+      if (!test_write_full(stalled_fds[0], &header, sizeof(header))
+        || !test_write_full(stalled_fds[0], payload, sizeof(limb_t))) {
+        errx(EXIT_FAILURE, "err: failed to write serve request");
+      }
     }
-    printf("\nread: %zu bytes\n", bytes_read);
+    shutdown(stalled_fds[0], SHUT_WR);
+    pthread_create(&thread, NULL, test_serve_connection, &args);
 
-    //print_limb_list(ll);
+    // Pipeline every request before reading any response
+    for (size_t i = 0; i < num_requests; i++) {
+      payload[0] = i + 1u;
+      serve_request_header_t header = { SERVE_OP_ENCODE, 0, i, sizeof(limb_t) };
+      if (!test_write_full(fds[0], &header, sizeof(header))
+        || !test_write_full(fds[0], payload, sizeof(limb_t))) {
+        errx(EXIT_FAILURE, "err: failed to write serve request");
+      }
+    }
+    shutdown(fds[0], SHUT_WR);
 
-    
-    if (*argv[1] == 'e') {
-      limb_dlist_t* buffer = new_limb_list();
+    collatz_workspace_t* ws = collatz_workspace_new();
+    for (size_t i = 0; i < num_requests; i++) {
+      serve_response_header_t header;
+      if (!test_read_full(fds[0], &header, sizeof(header))
+        || header.status != SERVE_STATUS_OK || header.id >= num_requests
+        || header.length > sizeof(payload)
+        || !test_read_full(fds[0], payload, header.length)) {
+        errx(EXIT_FAILURE, "err: bad serve response");
+      }
+      encoded_len[header.id] = header.length;
 
-      to_radix_custom(buffer, ll);
-      destroy_limb_list(ll);
-      ll = collatz_encode(buffer);
-      destroy_limb_list(buffer);
+      // Responses arrive in any order so check each one by decoding it
+      const unsigned char* decoded;
+      size_t decoded_len = collatz_decode_buffer(ws, payload, header.length, &decoded);
+      limb_t value = 0;
+      memcpy(&value, decoded, decoded_len);
+      if (value != header.id + 1u) {
+        printf("main: id: %llu  decoded: %llu\n", (limb_t) header.id, value);
+        errx(EXIT_FAILURE, "err: serve round trip mismatch");
+      }
     }
-    else if (*argv[1] == 'd') {
-      limb_dlist_t* buffer = collatz_decode(ll);
-      to_radix_pow2(ll, buffer);
-      destroy_limb_list(buffer);
+    collatz_workspace_free(ws);
+
+    for (size_t i = 0; i < num_requests; i++) {
+      if (encoded_len[i] == 0) errx(EXIT_FAILURE, "err: missing serve response");
     }
-    else {
-      print_usage(argv[0]);
-      destroy_limb_list(ll);
-      break;
+
+    pthread_join(thread, NULL);
+
+    // Now take the stalled client's responses so it can finish
+    size_t num_stalled_read = 0;
+    serve_response_header_t stalled_header;
+    while (test_read_full(stalled_fds[0], &stalled_header, sizeof(stalled_header))) {
+      if (stalled_header.length > sizeof(payload)
+        || !test_read_full(stalled_fds[0], payload, stalled_header.length)) {
+        errx(EXIT_FAILURE, "err: bad serve response");
+      }
+      num_stalled_read++;
     }
-    
-    canonicalize(ll);
-    
-    size_t bytes_write = write_file(ll, out_file);
-    if (bytes_write == __SIZE_MAX__) {
-      printf("err: failed to write to file\n");
-      destroy_limb_list(ll);
-      break;
+    pthread_join(stalled_thread, NULL);
+    if (num_stalled_read != num_stalled) errx(EXIT_FAILURE, "err: missing serve response");
+
+    // Serving must never delete a file that is not a socket
+    char path[] = "/tmp/collatz_serve_XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) err(EXIT_FAILURE, "err: failed to create temporary file");
+    close(fd);
+    if (serve_unix_socket(pool, path) || errno != EADDRINUSE || access(path, F_OK) != 0) {
+      errx(EXIT_FAILURE, "err: serve replaced a regular file");
+    }
+    unlink(path);
+
+    destroy_serve_pool(pool);
+    close(fds[0]);
+    close(fds[1]);
+    close(stalled_fds[0]);
+    close(stalled_fds[1]);
+  }
+
+  return 0;
+}
+
+
+int test_limb_growth() {
+  limb_dlist_t* ll = new_limb_list();
+  limb_dlist_t* copy = new_limb_list();
+
+  LOG_EXECUTION_TIME("Passed tests: %f seconds\n") {
+    // Crosses from heap memory into mapped huge pages and keeps growing
+    for (limb_t i = 0; i < (1u << 22); i++) {
+      resize_limb_list_to_length(ll, ll->length + 1);
+      insert_at_tail(ll, i * 2654435761u);
+
+      if (((uintptr_t) ll->handle % LL_ALIGNMENT) != 0) {
+        errx(EXIT_FAILURE, "err: limb memory is not aligned");
+      }
+      // Mappings stay on huge page boundaries however they are grown
+      if (ll->is_huge && ((uintptr_t) ll->handle % LL_HUGE_PAGE_SIZE) != 0) {
+        errx(EXIT_FAILURE, "err: limb mapping is not huge page aligned");
+      }
+    }
+
+    // Occupy the pages just past the mapping so growing has to move it
+    void* end = ll->handle + ll->container_size;
+    void* blocker = mmap(end, 4096, PROT_NONE,
+      MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    grow_limb_list(ll);
+    if (((uintptr_t) ll->handle % LL_HUGE_PAGE_SIZE) != 0) {
+      errx(EXIT_FAILURE, "err: moved limb mapping is not huge page aligned");
     }
+    if (blocker != MAP_FAILED) munmap(blocker, 4096);
 
-    printf("\nwrite: %zu bytes\n", bytes_write);
+    copy_limb_list(copy, ll);
+    for (limb_t i = 0; i < ll->length; i++) {
+      if (LL_INDEX(ll, i) != i * 2654435761u || LL_INDEX(copy, i) != LL_INDEX(ll, i)) {
+        errx(EXIT_FAILURE, "err: limb memory lost data while growing");
+      }
+    }
 
     destroy_limb_list(ll);
+    destroy_limb_list(copy);
   }
+
+  return 0;
 }
 
-int main(int argc, char* argv[]) {
-  if (argc != 4 && argc != 2) {
-    print_usage(argv[0]);
-    return 0;
+
+int test_encode_pow2() {
+  limb_dlist_t* ll = new_limb_list();
+  limb_dlist_t* pow2 = new_limb_list();
+  limb_dlist_t* custom = new_limb_list();
+  limb_t seed = 0x9e3779b97f4a7c15u;
+
+  LOG_EXECUTION_TIME("Passed tests: %f seconds\n") {
+    for (size_t i = 0; i < 256*64; i++) {
+      // Sweep small values then random values of up to 8 limbs
+      ll->length = 0;
+      if (i < 256*32) {
+        insert_at_tail(ll, i + 1u);
+      }
+      else {
+        for (size_t j = 0; j <= i % 8u; j++) {
+          seed ^= seed << 13u;
+          seed ^= seed >> 7u;
+          seed ^= seed << 17u;
+          insert_at_tail(ll, seed);
+        }
+      }
+
+      copy_limb_list(pow2, ll);
+      to_radix_custom(custom, ll);
+      limb_dlist_t* expected = collatz_encode(custom);
+      limb_dlist_t* collatz = collatz_encode_pow2(pow2, NULL);
+
+      if (!is_eq(expected, collatz)) {
+        printf("main: input: ");
+        print_limb_list(ll);
+        printf("main: expected: ");
+        print_limb_list(expected);
+        printf("main: collatz: ");
+        print_limb_list(collatz);
+        printf("\n");
+        errx(EXIT_FAILURE, "err: binary radix collatz mismatch");
+      }
+
+      destroy_limb_list(expected);
+      destroy_limb_list(collatz);
+    }
+
+    destroy_limb_list(ll);
+    destroy_limb_list(pow2);
+    destroy_limb_list(custom);
   }
 
-  if (argc == 2) {
-    if (*argv[1] == 't') {
-      test_convert();
-      test();
-      test_range();
-      test_range2();
+  return 0;
+}
+
+
+int test_decode_pow2() {
+  limb_dlist_t* ll = new_limb_list();
+  limb_dlist_t* input = new_limb_list();
+  limb_t seed = 0x2545f4914f6cdd1du;
+
+  LOG_EXECUTION_TIME("Passed tests: %f seconds\n") {
+    for (size_t i = 0; i < 256*64; i++) {
+      ll->length = 0;
+      if (i < 256*32) {
+        insert_at_tail(ll, i + 1u);
+      }
+      else {
+        for (size_t j = 0; j <= i % 8u; j++) {
+          seed ^= seed << 13u;
+          seed ^= seed >> 7u;
+          seed ^= seed << 17u;
+          insert_at_tail(ll, seed);
+        }
+      }
+      canonicalize(ll);
+
+      copy_limb_list(input, ll);
+      limb_dlist_t* collatz = collatz_encode_pow2(input, NULL);
+      limb_dlist_t* uncollatz = collatz_decode_pow2(collatz);
+
+      if (!is_eq(ll, uncollatz)) {
+        printf("main: input: ");
+        print_limb_list(ll);
+        printf("main: collatz: ");
+        print_limb_list(collatz);
+        printf("main: uncollatz: ");
+        print_limb_list(uncollatz);
+        printf("\n");
+        errx(EXIT_FAILURE, "err: binary radix uncollatz mismatch");
+      }
+
+      destroy_limb_list(collatz);
+      destroy_limb_list(uncollatz);
     }
-    else {
-      print_usage(argv[0]);
+
+    destroy_limb_list(ll);
+    destroy_limb_list(input);
+  }
+
+  return 0;
+}
+
+
+int test_fingerprint() {
+  limb_dlist_t* ll = new_limb_list();
+  limb_dlist_t* input = new_limb_list();
+  limb_t seed = 0xd1b54a32d192ed03u;
+
+  LOG_EXECUTION_TIME("Passed tests: %f seconds\n") {
+    for (size_t i = 0; i < 256*16; i++) {
+      ll->length = 0;
+      for (size_t j = 0; j <= i % 8u; j++) {
+        seed ^= seed << 13u;
+        seed ^= seed >> 7u;
+        seed ^= seed << 17u;
+        insert_at_tail(ll, seed);
+      }
+
+      copy_limb_list(input, ll);
+      limb_dlist_t* collatz = collatz_encode_pow2(input, NULL);
+
+      fingerprint_t expected_fp;
+      fingerprint_t actual_fp;
+      fingerprint_value(&expected_fp, ll, VERIFY_MAX_PRIMES);
+      fingerprint_parity_vector(&actual_fp, collatz, VERIFY_MAX_PRIMES);
+      if (!is_eq_fingerprint(&expected_fp, &actual_fp)) {
+        printf("main: input: ");
+        print_limb_list(ll);
+        errx(EXIT_FAILURE, "err: fingerprint mismatch");
+      }
+
+      // Flipping any parity bit must change the fingerprint
+      LL_INDEX(collatz, 0) ^= 1u;
+      fingerprint_parity_vector(&actual_fp, collatz, VERIFY_DEFAULT_PRIMES);
+      expected_fp.num_primes = VERIFY_DEFAULT_PRIMES;
+      if (is_eq_fingerprint(&expected_fp, &actual_fp)) {
+        printf("main: input: ");
+        print_limb_list(ll);
+        errx(EXIT_FAILURE, "err: fingerprint missed a corrupted parity vector");
+      }
+
+      destroy_limb_list(collatz);
     }
-    return 0;
+
+    destroy_limb_list(ll);
+    destroy_limb_list(input);
   }
-  
-  if (argc == 4) {
-    LOG_EXECUTION_TIME("Encoded in %f seconds\n") encode_main(argv);
+
+  return 0;
+}
+
+
+int test_stream() {
+  limb_dlist_t* ll = new_limb_list();
+  FILE *streamed_file = tmpfile();
+  FILE *expected_file = tmpfile();
+  if (streamed_file == NULL || expected_file == NULL) {
+    errx(EXIT_FAILURE, "err: failed to create temporary files");
   }
+
+  LOG_EXECUTION_TIME("Passed tests: %f seconds\n") {
+    size_t num_limbs = 5u * STREAM_BLOCK_LIMBS + 123u;
+    resize_limb_list_to_length(ll, num_limbs);
+
+    // Produce limbs in order like the encoders do
+    limb_stream_t* stream = new_limb_stream(streamed_file);
+    for (size_t i = 0; i < num_limbs; i++) {
+      insert_at_tail(ll, i * 0x9e3779b97f4a7c15u + 1u);
+      stream_finished_bits(stream, ll, (i + 1u) * LIMB_CONTAINER_BIT_LENGTH);
+    }
+    size_t streamed_bytes = finish_limb_stream(stream, ll);
+    size_t expected_bytes = write_file(ll, expected_file);
+
+    if (streamed_bytes != expected_bytes) {
+      errx(EXIT_FAILURE, "err: streamed %zu bytes but expected %zu", streamed_bytes, expected_bytes);
+    }
+
+    rewind(streamed_file);
+    rewind(expected_file);
+    int a, b;
+    do {
+      a = fgetc(streamed_file);
+      b = fgetc(expected_file);
+      if (a != b) errx(EXIT_FAILURE, "err: streamed output mismatch");
+    } while (a != EOF);
+
+    destroy_limb_list(ll);
+    fclose(streamed_file);
+    fclose(expected_file);
+  }
+
+  return 0;
+}
+
+
+int test_file_blocks() {
+  LOG_EXECUTION_TIME("Passed tests: %f seconds\n") {
+    // Sizes around the block and limb boundaries
+    const size_t sizes[] = { 1, 8, 13, FILE_BLOCK_BYTES, FILE_BLOCK_BYTES + 3u, 2u * FILE_BLOCK_BYTES + 8u };
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+      FILE *in_file = tmpfile();
+      FILE *out_file = tmpfile();
+      if (in_file == NULL || out_file == NULL) {
+        errx(EXIT_FAILURE, "err: failed to create temporary files");
+      }
+
+      // Nonzero last byte so that write_file has nothing to chop off
+      for (size_t i = 0; i < sizes[s]; i++) fputc((int) ((i * 131u + 7u) % 255u) + 1, in_file);
+      rewind(in_file);
+
+      limb_dlist_t* ll = new_limb_list();
+      size_t bytes_read = read_file(ll, in_file);
+      size_t bytes_write = write_file(ll, out_file);
+      if (bytes_read != sizes[s] || bytes_write != sizes[s]) {
+        errx(EXIT_FAILURE, "err: read %zu and wrote %zu of %zu bytes", bytes_read, bytes_write, sizes[s]);
+      }
+
+      rewind(in_file);
+      rewind(out_file);
+      int a, b;
+      do {
+        a = fgetc(in_file);
+        b = fgetc(out_file);
+        if (a != b) errx(EXIT_FAILURE, "err: block file round trip mismatch at %zu bytes", sizes[s]);
+      } while (a != EOF);
+
+      destroy_limb_list(ll);
+      fclose(in_file);
+      fclose(out_file);
+    }
+  }
+
+  return 0;
+}
+
+void fill_bench_input(limb_dlist_t* ll, size_t num_limbs, limb_t seed);
+
+int test_radix_runs() {
+  limb_dlist_t* pow2 = new_limb_list();
+  limb_dlist_t* x = new_limb_list();
+  limb_dlist_t* expected = new_limb_list();
+  limb_dlist_t* buffer = new_limb_list();
+
+  LOG_EXECUTION_TIME("Passed tests: %f seconds\n") {
+    size_t max_odd_run = LIMB_RADIX_TWOS < LIMB_RADIX_THREES ? LIMB_RADIX_TWOS : LIMB_RADIX_THREES;
+
+    for (size_t num_limbs = 1; num_limbs <= 9; num_limbs += 2) {
+      fill_bench_input(pow2, num_limbs, 0xda942042e4dd58b5u + num_limbs);
+      to_radix_custom(x, pow2);
+
+      // Every single pass kernel has to match k single steps
+      for (size_t k = 1; k <= LIMB_RADIX_TWOS; k++) {
+        copy_limb_list(expected, x);
+        for (size_t j = 0; j < k; j++) right_shift(expected);
+        copy_limb_list(buffer, x);
+        right_shift_by(buffer, k);
+        if (!is_eq(expected, buffer)) errx(EXIT_FAILURE, "err: right_shift_by %zu mismatch", k);
+
+        copy_limb_list(expected, x);
+        for (size_t j = 0; j < k; j++) left_shift(expected);
+        copy_limb_list(buffer, x);
+        left_shift_by(buffer, k);
+        if (!is_eq(expected, buffer)) errx(EXIT_FAILURE, "err: left_shift_by %zu mismatch", k);
+      }
+
+      for (size_t k = 1; k <= LIMB_RADIX_THREES; k++) {
+        copy_limb_list(expected, x);
+        for (size_t j = 0; j < k; j++) divide_by_three(expected);
+        copy_limb_list(buffer, x);
+        divide_by_three_pow(buffer, k);
+        if (!is_eq(expected, buffer)) errx(EXIT_FAILURE, "err: divide_by_three_pow %zu mismatch", k);
+      }
+
+      for (size_t k = 1; k <= max_odd_run; k++) {
+        // 2^k x - 1 stays odd for k steps of (3x + 1) / 2
+        limb_dlist_t* odd = buffer;
+        copy_limb_list(odd, x);
+        for (size_t j = 0; j < k; j++) left_shift(odd);
+        minus_one(odd);
+
+        copy_limb_list(expected, odd);
+        for (size_t j = 0; j < k; j++) fused_multiply_by_three_increment_halve(expected);
+        fused_odd_steps(odd, k);
+        if (!is_eq(expected, odd)) errx(EXIT_FAILURE, "err: fused_odd_steps %zu mismatch", k);
+
+        for (size_t j = 0; j < k; j++) fused_double_decrement_divide_by_three(expected);
+        fused_inverse_odd_steps(odd, k);
+        if (!is_eq(expected, odd)) errx(EXIT_FAILURE, "err: fused_inverse_odd_steps %zu mismatch", k);
+      }
+    }
+  }
+
+  destroy_limb_list(buffer);
+  destroy_limb_list(pow2);
+  destroy_limb_list(x);
+  destroy_limb_list(expected);
+  return 0;
+}
+
+int test_stats() {
+  LOG_EXECUTION_TIME("Passed tests: %f seconds\n") {
+    limb_dlist_t* ll = new_limb_list();
+
+    for (limb_t n = 0; n < 20000; n++) {
+      // Reference stepping one step at a time
+      collatz_stats_t expected = {0};
+      wide_limb_t x = n, peak = n;
+      while (x > 1u) {
+        expected.odd_steps += x % 2u;
+        x = x % 2u == 0 ? x / 2u : (3u * x + 1u) / 2u;
+        expected.steps++;
+        if (x > peak) peak = x;
+        if (expected.drop_step == 0 && x < n) expected.drop_step = expected.steps;
+      }
+      while (peak != 0) {
+        expected.peak_bits++;
+        peak >>= 1u;
+      }
+
+      collatz_stats_t actual = collatz_stats_value(n);
+      ll->length = 0;
+      if (n != 0) insert_at_tail(ll, n);
+      collatz_stats_t actual_pow2 = collatz_stats_pow2(ll);
+
+      if (memcmp(&actual, &expected, sizeof(collatz_stats_t)) != 0) {
+        errx(EXIT_FAILURE, "err: stats of %llu do not match the reference", n);
+      }
+      if (memcmp(&actual, &actual_pow2, sizeof(collatz_stats_t)) != 0) {
+        errx(EXIT_FAILURE, "err: binary radix stats of %llu disagree", n);
+      }
+    }
+
+    // The counters have to agree with the parity vector
+    limb_dlist_t* buffer = new_limb_list();
+    for (size_t num_limbs = 1; num_limbs <= 12; num_limbs += 1) {
+      fill_bench_input(ll, num_limbs, 0x853c49e6748fea9bu + num_limbs);
+      copy_limb_list(buffer, ll);
+      limb_dlist_t* collatz = collatz_encode_pow2(buffer, NULL);
+
+      collatz_stats_t stats = collatz_stats_pow2(ll);
+      limb_t ones = 0;
+      for (size_t i = 0; i < collatz->length; i++) ones += (limb_t) __builtin_popcountll(LL_INDEX(collatz, i));
+
+      if (stats.steps + 1u != get_bit_length(collatz) || stats.odd_steps + 1u != ones) {
+        errx(EXIT_FAILURE, "err: stats disagree with the parity vector at %zu limbs", num_limbs);
+      }
+      if (num_limbs == 1) {
+        fill_bench_input(ll, num_limbs, 0x853c49e6748fea9bu + num_limbs);
+        collatz_stats_t value_stats = collatz_stats_value(LL_HEAD(ll));
+        if (memcmp(&stats, &value_stats, sizeof(collatz_stats_t)) != 0) {
+          errx(EXIT_FAILURE, "err: stats of a 64-bit value disagree");
+        }
+      }
+      destroy_limb_list(collatz);
+    }
+
+    destroy_limb_list(ll);
+    destroy_limb_list(buffer);
+  }
+
+  return 0;
+}
+
+int test_tuning() {
+  FILE *file = tmpfile();
+  if (file == NULL) {
+    errx(EXIT_FAILURE, "err: failed to create temporary files");
+  }
+
+  LOG_EXECUTION_TIME("Passed tests: %f seconds\n") {
+    collatz_tuning_t expected;
+    default_collatz_tuning(&expected);
+    expected.threads = 3;
+    expected.fixed_max_limbs = 4;
+    expected.range_batch_size = 1000;
+
+    if (write_collatz_tuning(&expected, file) == __SIZE_MAX__) {
+      errx(EXIT_FAILURE, "err: failed to write tuning profile");
+    }
+    fputs("# comment\n\n  initial_limbs = 32  # trailing comment\n", file);
+    rewind(file);
+
+    collatz_tuning_t actual;
+    default_collatz_tuning(&actual);
+    if (read_collatz_tuning(&actual, file) != 8u) {
+      errx(EXIT_FAILURE, "err: failed to read tuning profile");
+    }
+    expected.initial_limbs = 32;
+    if (memcmp(&expected, &actual, sizeof(collatz_tuning_t)) != 0) {
+      errx(EXIT_FAILURE, "err: tuning profile did not round trip");
+    }
+
+    // Unknown keys and out of range values leave the profile untouched
+    const char* malformed[] = { "bogus=1\n", "initial_limbs=24\n", "fixed_max_limbs=32\n", "threads\n", "threads=x\n" };
+    for (size_t m = 0; m < sizeof(malformed) / sizeof(malformed[0]); m++) {
+      rewind(file);
+      if (ftruncate(fileno(file), 0) != 0) errx(EXIT_FAILURE, "err: failed to truncate");
+      fputs(malformed[m], file);
+      rewind(file);
+      if (read_collatz_tuning(&actual, file) != __SIZE_MAX__) {
+        errx(EXIT_FAILURE, "err: accepted malformed tuning profile: %s", malformed[m]);
+      }
+      if (memcmp(&expected, &actual, sizeof(collatz_tuning_t)) != 0) {
+        errx(EXIT_FAILURE, "err: malformed tuning profile changed the tuning");
+      }
+    }
+
+    // Every fixed kernel limit has to produce the same encoding
+    const collatz_tuning_t saved = *get_collatz_tuning();
+
+    // New lists always have room for a few limbs
+    collatz_tuning_t small = saved;
+    small.initial_limbs = 4;
+    set_collatz_tuning(&small);
+    if (get_collatz_tuning()->initial_limbs != LL_INITIAL_SIZE) {
+      errx(EXIT_FAILURE, "err: initial_limbs was not clamped");
+    }
+
+    // Lists are released the way they were allocated, whatever the
+    // huge page threshold is by then
+    collatz_tuning_t kinds = saved;
+    kinds.huge_page_threshold = __SIZE_MAX__;
+    set_collatz_tuning(&kinds);
+    limb_dlist_t* heap = new_limb_list();
+    resize_limb_list_to_length(heap, LL_HUGE_PAGE_SIZE / sizeof(limb_t));
+    kinds.huge_page_threshold = LL_HUGE_PAGE_SIZE;
+    set_collatz_tuning(&kinds);
+    limb_dlist_t* mapped = new_limb_list();
+    resize_limb_list_to_length(mapped, LL_HUGE_PAGE_SIZE / sizeof(limb_t));
+    if (heap->is_huge || !mapped->is_huge) {
+      errx(EXIT_FAILURE, "err: limb lists allocated with the wrong kind of memory");
+    }
+    grow_limb_list(heap);
+    destroy_limb_list(heap);
+    kinds.huge_page_threshold = __SIZE_MAX__;
+    set_collatz_tuning(&kinds);
+    grow_limb_list(mapped);
+    destroy_limb_list(mapped);
+    set_collatz_tuning(&saved);
+
+    limb_dlist_t* input = new_limb_list();
+    limb_dlist_t* buffer = new_limb_list();
+    for (size_t num_limbs = 1; num_limbs <= 20; num_limbs += 3) {
+      fill_bench_input(input, num_limbs, 0x2545f4914f6cdd1du + num_limbs);
+
+      // The encoder consumes its input
+      collatz_tuning_t tuning = saved;
+      tuning.fixed_max_limbs = 0;
+      set_collatz_tuning(&tuning);
+      to_radix_custom(buffer, input);
+      limb_dlist_t* generic = collatz_encode(buffer);
+
+      tuning.fixed_max_limbs = FIXED_MAX_LIMBS;
+      tuning.fixed_chunk_steps = 7;
+      set_collatz_tuning(&tuning);
+      to_radix_custom(buffer, input);
+      limb_dlist_t* fixed = collatz_encode(buffer);
+      limb_dlist_t* decoded = collatz_decode(fixed);
+      to_radix_custom(buffer, input);
+
+      if (!is_eq(generic, fixed) || !is_eq(decoded, buffer)) {
+        errx(EXIT_FAILURE, "err: tuned kernels disagree at %zu limbs", num_limbs);
+      }
+      destroy_limb_list(generic);
+      destroy_limb_list(fixed);
+      destroy_limb_list(decoded);
+    }
+    set_collatz_tuning(&saved);
+
+    destroy_limb_list(input);
+    destroy_limb_list(buffer);
+    fclose(file);
+  }
+
+  return 0;
+}
+
+void test_limb_list() {
+  limb_dlist_t* ll = new_limb_list();
+  printf("empty: ");
+  print_limb_list(ll);
+  
+  for (size_t i = 0; i < 10; i++) {
+    insert_at_tail(ll, (limb_t) i);
+  }
+  
+  printf("insert 0-9 at tail: ");
+  print_limb_list(ll);
+  
+
+  grow_limb_list(ll);
+  printf("grow list: ");
+  print_limb_list(ll);
+  
+  for (size_t i = 0; i < 6; i++) {
+    insert_at_tail(ll, (limb_t) i);
+  }
+  printf("insert 0-6 at tail: ");
+  print_limb_list(ll);
+  
+  for (size_t i = 0; i < 4; i++) {
+    remove_at_tail(ll);
+  }
+  
+  printf("remove 3-6 at tail: ");
+  print_limb_list(ll);
+  
+  destroy_limb_list(ll);
+}
+
+void print_usage(char* prog_name) {
+  fprintf(stderr, "Usage: %s <encode|decode> <input_file|-> <output_file|-> [--cache=<cache_file>] [--radix=<custom|binary>] [--verify[=primes]]\n", prog_name);
+  fprintf(stderr, "Usage: %s <verify> <source_file|-> <encoded_file|-> [primes]\n", prog_name);
+  fprintf(stderr, "Usage: %s <range> <start> <end> [sieve_log2]\n", prog_name);
+  fprintf(stderr, "Usage: %s <cache> <log2_bound> <cache_file>\n", prog_name);
+  fprintf(stderr, "Usage: %s <stats> <n|start:end|file|->...\n", prog_name);
+  fprintf(stderr, "Usage: %s <serve> <socket_path|-> [threads]\n", prog_name);
+  fprintf(stderr, "Usage: %s <bench>\n", prog_name);
+  fprintf(stderr, "Usage: %s <tune> [profile_path]\n", prog_name);
+  fprintf(stderr, "Usage: %s <test>\n", prog_name);
+}
+
+
+double wall_time() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+void fill_bench_input(limb_dlist_t* ll, size_t num_limbs, limb_t seed) {
+  ll->length = 0;
+  resize_limb_list_to_length(ll, num_limbs);
+  for (size_t i = 0; i < num_limbs; i++) {
+    seed ^= seed << 13u;
+    seed ^= seed >> 7u;
+    seed ^= seed << 17u;
+    insert_at_tail(ll, seed);
+  }
+}
+
+int bench_main() {
+  const size_t sizes[] = { 8, 32, 128, 512 };
+  limb_dlist_t* input = new_limb_list();
+  limb_dlist_t* buffer = new_limb_list();
+  limb_dlist_t* decoded = new_limb_list();
+
+  printf("radix: 2^%u 3^%u, base %llu\n", (unsigned) LIMB_RADIX_TWOS, (unsigned) LIMB_RADIX_THREES, LIMB_BASE);
+  printf("%8s %8s %14s %14s %14s %14s %14s %14s\n", "bytes", "rounds",
+    "custom enc/s", "binary enc/s", "custom dec/s", "binary dec/s", "enc passes/bit", "dec passes/bit");
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    size_t num_limbs = sizes[s];
+    size_t rounds = 4096u / num_limbs;
+
+    double custom_encode_seconds = 0;
+    double binary_encode_seconds = 0;
+    double custom_decode_seconds = 0;
+    double binary_decode_seconds = 0;
+    size_t encode_passes = 0;
+    size_t decode_passes = 0;
+    size_t encoded_bits = 0;
+
+    for (size_t r = 0; r < rounds; r++) {
+      fill_bench_input(input, num_limbs, 0x9e3779b97f4a7c15u + r);
+
+      double start = wall_time();
+      to_radix_custom(buffer, input);
+      take_custom_radix_passes();
+      limb_dlist_t* expected = collatz_encode(buffer);
+      encode_passes += take_custom_radix_passes();
+      custom_encode_seconds += wall_time() - start;
+      encoded_bits += get_bit_length(expected);
+
+      copy_limb_list(buffer, input);
+      start = wall_time();
+      limb_dlist_t* collatz = collatz_encode_pow2(buffer, NULL);
+      binary_encode_seconds += wall_time() - start;
+
+      if (!is_eq(expected, collatz)) {
+        errx(EXIT_FAILURE, "err: bench encoders disagree");
+      }
+
+      start = wall_time();
+      take_custom_radix_passes();
+      limb_dlist_t* uncollatz = collatz_decode(collatz);
+      decode_passes += take_custom_radix_passes();
+      to_radix_pow2(decoded, uncollatz);
+      custom_decode_seconds += wall_time() - start;
+      destroy_limb_list(uncollatz);
+
+      if (!is_eq(input, decoded)) {
+        errx(EXIT_FAILURE, "err: bench custom radix decode mismatch");
+      }
+
+      start = wall_time();
+      uncollatz = collatz_decode_pow2(collatz);
+      binary_decode_seconds += wall_time() - start;
+
+      if (!is_eq(input, uncollatz)) {
+        errx(EXIT_FAILURE, "err: bench binary radix decode mismatch");
+      }
+
+      destroy_limb_list(expected);
+      destroy_limb_list(collatz);
+      destroy_limb_list(uncollatz);
+    }
+
+    printf("%8zu %8zu %14.1f %14.1f %14.1f %14.1f", num_limbs * sizeof(limb_t), rounds,
+      (double) rounds / custom_encode_seconds, (double) rounds / binary_encode_seconds,
+      (double) rounds / custom_decode_seconds, (double) rounds / binary_decode_seconds);
+    // Passes are only counted in COLLATZ_COUNT_PASSES builds
+#ifdef COLLATZ_COUNT_PASSES
+    printf(" %14.3f %14.3f\n",
+      (double) encode_passes / (double) encoded_bits, (double) decode_passes / (double) encoded_bits);
+#else
+    printf(" %14s %14s\n", "-", "-");
+    (void) encode_passes;
+    (void) decode_passes;
+#endif
+  }
+
+  destroy_limb_list(input);
+  destroy_limb_list(buffer);
+  destroy_limb_list(decoded);
+  return 0;
+}
+
+
+
+#define TUNE_REPEATS 3u
+#define TUNE_MIN_GAIN 0.98
+
+static range_sieve_t* tune_sieve;
+
+// Encode and decode round trips of small values, where the fixed
+// kernels and the initial container size matter
+double tune_small_values() {
+  limb_dlist_t* input = new_limb_list();
+  limb_dlist_t* buffer = new_limb_list();
+  limb_dlist_t* decoded = new_limb_list();
+
+  double start = wall_time();
+  for (size_t num_limbs = 1; num_limbs <= 24; num_limbs++) {
+    for (size_t r = 0; r < 8; r++) {
+      fill_bench_input(input, num_limbs, 0x9e3779b97f4a7c15u + r);
+      to_radix_custom(buffer, input);
+      limb_dlist_t* collatz = collatz_encode(buffer);
+      limb_dlist_t* uncollatz = collatz_decode(collatz);
+      to_radix_pow2(decoded, uncollatz);
+
+      if (!is_eq(input, decoded)) {
+        errx(EXIT_FAILURE, "err: tune round trip mismatch");
+      }
+      destroy_limb_list(collatz);
+      destroy_limb_list(uncollatz);
+    }
+  }
+  double seconds = wall_time() - start;
+
+  destroy_limb_list(input);
+  destroy_limb_list(buffer);
+  destroy_limb_list(decoded);
+  return seconds;
+}
+
+// Grows one list to 32 MiB the way the encoders do
+double tune_growth() {
+  limb_dlist_t* ll = new_limb_list();
+
+  double start = wall_time();
+  for (size_t length = 1; length <= ((size_t) 1u << 22); length += length / 4u + 1u) {
+    resize_limb_list_to_length(ll, length);
+    memset(ll->handle + ll->length, 0xff, (length - ll->length) * sizeof(limb_t));
+    ll->length = length;
+  }
+  double seconds = wall_time() - start;
+
+  destroy_limb_list(ll);
+  return seconds;
+}
+
+double tune_range() {
+  limb_t start = (limb_t) 1u << 40;
+  range_result_t result = verify_range(tune_sieve, start, start + ((limb_t) 1u << 22));
+  if (result.has_failed) {
+    errx(EXIT_FAILURE, "err: tune range failed at %llu", result.failed);
+  }
+  return result.seconds;
+}
+
+double tune_fingerprint() {
+  limb_dlist_t* ll = new_limb_list();
+  fill_bench_input(ll, (size_t) 1u << 15, 0x9e3779b97f4a7c15u);
+
+  fingerprint_t fp;
+  double start = wall_time();
+  fingerprint_parity_vector(&fp, ll, VERIFY_DEFAULT_PRIMES);
+  double seconds = wall_time() - start;
+
+  destroy_limb_list(ll);
+  return seconds;
+}
+
+// Keeps the fastest candidate for one knob of `tuning`. The current
+// value is measured first and only replaced by a clear win.
+void tune_knob(collatz_tuning_t* tuning, size_t* knob, const char* name,
+    const size_t* candidates, size_t num_candidates, double (*workload)()) {
+  size_t best_value = *knob;
+  double best_seconds = 0;
+
+  for (size_t c = 0; c <= num_candidates; c++) {
+    *knob = c == 0 ? best_value : candidates[c - 1];
+    if (c != 0 && *knob == best_value) continue;
+
+    set_collatz_tuning(tuning);
+    double seconds = workload();
+    for (size_t r = 1; r < TUNE_REPEATS; r++) {
+      double repeat_seconds = workload();
+      if (repeat_seconds < seconds) seconds = repeat_seconds;
+    }
+
+    printf("tune: %-20s %14zu %12.6f s\n", name, *knob, seconds);
+    if (c == 0 || seconds < best_seconds * TUNE_MIN_GAIN) {
+      best_value = *knob;
+      best_seconds = seconds;
+    }
+  }
+
+  *knob = best_value;
+  set_collatz_tuning(tuning);
+}
+
+int tune_main(int argc, char* argv[]) {
+  if (argc != 2 && argc != 3) {
+    print_usage(argv[0]);
+    return 0;
+  }
+
+  char default_path[4096];
+  const char* path = argc == 3 ? argv[2] : collatz_tuning_path(default_path, sizeof(default_path));
+  if (path == NULL) {
+    errx(EXIT_FAILURE, "err: set $%s or $HOME to choose where the profile goes", TUNING_PATH_ENV);
+  }
+
+  // Every knob starts from the defaults, not from a stale profile
+  collatz_tuning_t tuning;
+  default_collatz_tuning(&tuning);
+  set_collatz_tuning(&tuning);
+  tune_sieve = new_range_sieve(RANGE_SIEVE_DEFAULT_LOG2);
+
+  size_t threads[64];
+  size_t num_threads = 0;
+  size_t num_procs = (size_t) omp_get_num_procs();
+  for (size_t t = 1; t < num_procs && num_threads < 63; t *= 2u) threads[num_threads++] = t;
+  threads[num_threads++] = num_procs;
+  tuning.threads = num_procs;
+  tune_knob(&tuning, &tuning.threads, "threads", threads, num_threads, tune_range);
+
+  const size_t batch_sizes[] = { 256, 1024, 4096, 16384, 65536 };
+  tune_knob(&tuning, &tuning.range_batch_size, "range_batch_size",
+    batch_sizes, sizeof(batch_sizes) / sizeof(batch_sizes[0]), tune_range);
+
+  const size_t segment_bits[] = { (size_t) 1u << 14, (size_t) 1u << 16, (size_t) 1u << 18, (size_t) 1u << 20 };
+  tune_knob(&tuning, &tuning.verify_segment_bits, "verify_segment_bits",
+    segment_bits, sizeof(segment_bits) / sizeof(segment_bits[0]), tune_fingerprint);
+
+  const size_t max_limbs[] = { 0, 1, 2, 4, 8, 16 };
+  tune_knob(&tuning, &tuning.fixed_max_limbs, "fixed_max_limbs",
+    max_limbs, sizeof(max_limbs) / sizeof(max_limbs[0]), tune_small_values);
+
+  const size_t chunk_steps[] = { 32, 64, 256, 1024, 4096 };
+  tune_knob(&tuning, &tuning.fixed_chunk_steps, "fixed_chunk_steps",
+    chunk_steps, sizeof(chunk_steps) / sizeof(chunk_steps[0]), tune_small_values);
+
+  const size_t initial_limbs[] = { 16, 32, 64, 128 };
+  tune_knob(&tuning, &tuning.initial_limbs, "initial_limbs",
+    initial_limbs, sizeof(initial_limbs) / sizeof(initial_limbs[0]), tune_small_values);
+
+  const size_t thresholds[] = { LL_HUGE_PAGE_SIZE, 4u * LL_HUGE_PAGE_SIZE, 16u * LL_HUGE_PAGE_SIZE, __SIZE_MAX__ };
+  tune_knob(&tuning, &tuning.huge_page_threshold, "huge_page_threshold",
+    thresholds, sizeof(thresholds) / sizeof(thresholds[0]), tune_growth);
+
+  destroy_range_sieve(tune_sieve);
+
+  FILE *file = fopen(path, "w");
+  if (file == NULL) {
+    errx(EXIT_FAILURE, "err: failed to open %s in write mode", path);
+  }
+  fprintf(file, "# written by collatz tune\n");
+  size_t bytes_write = write_collatz_tuning(&tuning, file);
+  if (fclose(file) != 0 || bytes_write == __SIZE_MAX__) {
+    errx(EXIT_FAILURE, "err: failed to write %s", path);
+  }
+  printf("tune: wrote %s\n", path);
+  return 0;
+}
+
+
+int range_main(int argc, char* argv[]) {
+  if (argc != 4 && argc != 5) {
+    print_usage(argv[0]);
+    return 0;
+  }
+
+  limb_t start = strtoull(argv[2], NULL, 0);
+  limb_t end = strtoull(argv[3], NULL, 0);
+  size_t log2_size = argc == 5 ? strtoull(argv[4], NULL, 0) : RANGE_SIEVE_DEFAULT_LOG2;
+
+  if (log2_size > RANGE_SIEVE_MAX_LOG2) {
+    errx(EXIT_FAILURE, "err: sieve_log2 must be at most %u", RANGE_SIEVE_MAX_LOG2);
+  }
+
+  range_sieve_t* sieve;
+  LOG_EXECUTION_TIME("Built sieve in %f seconds\n") sieve = new_range_sieve(log2_size);
+  printf("sieve: 2^%zu residues, %zu survivors\n", log2_size, sieve->length);
+
+  range_result_t result = verify_range(sieve, start, end);
+  destroy_range_sieve(sieve);
+
+  printf("range: [%llu, %llu)  checked: %llu of %llu\n",
+    start, end, result.checked, result.count);
+  printf("range: %f seconds, %.0f numbers per second\n",
+    result.seconds, (double) result.count / result.seconds);
+
+  if (result.has_failed) {
+    errx(EXIT_FAILURE, "err: %llu did not drop below itself in %u steps",
+      result.failed, RANGE_MAX_STEPS);
+  }
+  return 0;
+}
+
+
+int cache_main(int argc, char* argv[]) {
+  if (argc != 4) {
+    print_usage(argv[0]);
+    return 0;
+  }
+
+  size_t log2_bound = strtoull(argv[2], NULL, 0);
+  if (log2_bound > COLLATZ_CACHE_MAX_LOG2) {
+    errx(EXIT_FAILURE, "err: log2_bound must be at most %u", COLLATZ_CACHE_MAX_LOG2);
+  }
+
+  FILE *out_file = fopen(argv[3], "wb");
+  if (out_file == NULL) {
+    errx(EXIT_FAILURE, "err: failed to open file in write binary mode");
+  }
+
+  collatz_cache_t* cache;
+  LOG_EXECUTION_TIME("Built cache in %f seconds\n") cache = build_collatz_cache(log2_bound);
+
+  size_t bytes_write = write_collatz_cache(cache, out_file);
+  destroy_collatz_cache(cache);
+  fclose(out_file);
+
+  if (bytes_write == __SIZE_MAX__) {
+    errx(EXIT_FAILURE, "err: failed to write cache file");
+  }
+  printf("write: %zu bytes\n", bytes_write);
+  return 0;
+}
+
+
+int serve_main(int argc, char* argv[]) {
+  if (argc != 3 && argc != 4) {
+    print_usage(argv[0]);
+    return 0;
+  }
+
+  long num_threads = argc == 4 ? strtol(argv[3], NULL, 0) : (long) tuned_num_threads();
+  if (num_threads < 1) num_threads = 1;
+
+  // A client hanging up should only drop its own connection
+  signal(SIGPIPE, SIG_IGN);
+  serve_pool_t* pool = new_serve_pool((size_t) num_threads);
+
+  if (strcmp(argv[2], "-") == 0) {
+    fprintf(stderr, "serve: stdin/stdout with %ld workers\n", num_threads);
+    serve_connection(pool, STDIN_FILENO, STDOUT_FILENO);
+    destroy_serve_pool(pool);
+    return 0;
+  }
+
+  fprintf(stderr, "serve: %s with %ld workers\n", argv[2], num_threads);
+  serve_unix_socket(pool, argv[2]);
+  int serve_errno = errno;
+  destroy_serve_pool(pool);
+  errno = serve_errno;
+  err(EXIT_FAILURE, "err: failed to serve on socket: %s", argv[2]);
+}
+
+
+// "-" names stdin or stdout depending on the mode
+bool is_stdio_path(const char* path) {
+  return strcmp(path, "-") == 0;
+}
+
+FILE* open_file(const char* path, const char* mode) {
+  if (!is_stdio_path(path)) return fopen(path, mode);
+  return *mode == 'r' ? stdin : stdout;
+}
+
+void print_stats_row(const char* input, limb_t value, collatz_stats_t* stats) {
+  if (input != NULL) printf("%s,", input);
+  else printf("%llu,", value);
+  printf("%llu,%llu,%llu,%llu\n", stats->steps, stats->odd_steps, stats->peak_bits, stats->drop_step);
+}
+
+void flush_stats_batch(limb_t* values, collatz_stats_t* stats, size_t* length) {
+  collatz_stats_batch(values, *length, stats);
+  for (size_t i = 0; i < *length; i++) print_stats_row(NULL, values[i], &stats[i]);
+  *length = 0;
+}
+
+// Parses `n` or `start:end` into [start, end), false if arg is not numeric
+bool parse_stats_range(const char* arg, limb_t* start, limb_t* end) {
+  char* rest;
+  if (*arg < '0' || *arg > '9') return false;
+  *start = strtoull(arg, &rest, 0);
+  if (*rest == '\0') {
+    // The exclusive end would wrap to 0, and strtoull saturates
+    // values past 64 bits to this same maximum
+    if (*start == ULLONG_MAX) errx(EXIT_FAILURE, "err: stats value out of range: %s", arg);
+    *end = *start + 1u;
+    return true;
+  }
+  if (*rest != ':' || rest[1] < '0' || rest[1] > '9') return false;
+  *end = strtoull(rest + 1, &rest, 0);
+  return *rest == '\0';
+}
+
+int stats_main(int argc, char* argv[]) {
+  if (argc < 3) {
+    print_usage(argv[0]);
+    return 0;
+  }
+
+  limb_t* values = (limb_t*) malloc(sizeof(limb_t) * STATS_BATCH_SIZE);
+  collatz_stats_t* stats = (collatz_stats_t*) malloc(sizeof(collatz_stats_t) * STATS_BATCH_SIZE);
+  if (values == NULL || stats == NULL) {
+    errx(EXIT_FAILURE, "oom: failed to allocate stats batch");
+  }
+  size_t length = 0;
+
+  printf("input,steps,odd_steps,peak_bits,drop_step\n");
+  for (int a = 2; a < argc; a++) {
+    limb_t start, end;
+    if (parse_stats_range(argv[a], &start, &end)) {
+      // Consecutive numbers and ranges share batches
+      for (limb_t n = start; n < end; n++) {
+        values[length++] = n;
+        if (length == STATS_BATCH_SIZE) flush_stats_batch(values, stats, &length);
+      }
+      continue;
+    }
+
+    // Keep the rows in argument order
+    flush_stats_batch(values, stats, &length);
+
+    FILE *file = open_file(argv[a], "rb");
+    if (file == NULL) {
+      errx(EXIT_FAILURE, "err: failed to open file in read binary mode: %s", argv[a]);
+    }
+    limb_dlist_t* ll = new_limb_list();
+    size_t bytes_read = read_file(ll, file);
+    if (file != stdin) fclose(file);
+    if (bytes_read == __SIZE_MAX__) {
+      errx(EXIT_FAILURE, "err: failed to read from file: %s", argv[a]);
+    }
+
+    collatz_stats_t file_stats = collatz_stats_pow2(ll);
+    print_stats_row(argv[a], 0, &file_stats);
+    destroy_limb_list(ll);
+  }
+  flush_stats_batch(values, stats, &length);
+
+  free(values);
+  free(stats);
+  return 0;
+}
+
+
+int verify_main(int argc, char* argv[]) {
+  if (argc != 4 && argc != 5) {
+    print_usage(argv[0]);
+    return 0;
+  }
+
+  size_t num_primes = argc == 5 ? strtoull(argv[4], NULL, 0) : VERIFY_DEFAULT_PRIMES;
+  if (num_primes == 0 || num_primes > VERIFY_MAX_PRIMES) {
+    errx(EXIT_FAILURE, "err: primes must be between 1 and %u", VERIFY_MAX_PRIMES);
+  }
+
+  // stdin can only be read once
+  if (is_stdio_path(argv[2]) && is_stdio_path(argv[3])) {
+    errx(EXIT_FAILURE, "err: only one of the source and encoded files can be -");
+  }
+
+  FILE *source_file = open_file(argv[2], "rb");
+  FILE *encoded_file = open_file(argv[3], "rb");
+  if (source_file == NULL || encoded_file == NULL) {
+    errx(EXIT_FAILURE, "err: failed to open file in read binary mode");
+  }
+
+  limb_dlist_t* source = new_limb_list();
+  limb_dlist_t* encoded = new_limb_list();
+  bool is_read = read_file(source, source_file) != __SIZE_MAX__
+    && read_file(encoded, encoded_file) != __SIZE_MAX__;
+  if (source_file != stdin) fclose(source_file);
+  if (encoded_file != stdin) fclose(encoded_file);
+  if (!is_read) {
+    errx(EXIT_FAILURE, "err: failed to read from file");
+  }
+
+  fingerprint_t expected_fp;
+  fingerprint_t actual_fp;
+  LOG_EXECUTION_TIME("Verified in %f seconds\n") {
+    fingerprint_value(&expected_fp, source, num_primes);
+    fingerprint_parity_vector(&actual_fp, encoded, num_primes);
+  }
+
+  destroy_limb_list(source);
+  destroy_limb_list(encoded);
+
+  if (!is_eq_fingerprint(&expected_fp, &actual_fp)) {
+    errx(EXIT_FAILURE, "err: fingerprint mismatch, %s does not decode to %s", argv[3], argv[2]);
+  }
+  printf("verify: fingerprints match modulo %zu primes\n", num_primes);
+  return 0;
+}
+
+
+typedef struct encode_options {
+  const char* cache_path;
+  bool is_binary_radix;
+  size_t verify_primes;
+} encode_options_t;
+
+bool parse_encode_options(encode_options_t* options, int argc, char* argv[]) {
+  options->cache_path = NULL;
+  options->is_binary_radix = false;
+  options->verify_primes = 0;
+
+  for (int i = 4; i < argc; i++) {
+    if (strncmp(argv[i], "--cache=", 8) == 0) {
+      options->cache_path = argv[i] + 8;
+    }
+    else if (strcmp(argv[i], "--radix=binary") == 0) {
+      options->is_binary_radix = true;
+    }
+    else if (strcmp(argv[i], "--radix=custom") == 0) {
+      options->is_binary_radix = false;
+    }
+    else if (strcmp(argv[i], "--verify") == 0) {
+      options->verify_primes = VERIFY_DEFAULT_PRIMES;
+    }
+    else if (strncmp(argv[i], "--verify=", 9) == 0) {
+      options->verify_primes = strtoull(argv[i] + 9, NULL, 0);
+      if (options->verify_primes == 0 || options->verify_primes > VERIFY_MAX_PRIMES) return false;
+    }
+    else {
+      return false;
+    }
+  }
+  return true;
+}
+
+
+void encode_main(char* argv[], encode_options_t* options) {
+  // Status goes to stderr when stdout carries the output
+  FILE *log = is_stdio_path(argv[3]) ? stderr : stdout;
+
+  FILE *in_file = open_file(argv[2], "rb");
+  if (in_file == NULL) {
+    errx(EXIT_FAILURE, "err: failed to open file in read binary mode");
+  }
+  fprintf(log, "file: open input: %s\n", argv[2]);
+
+  // Opened once so that pipes work, the stream and write_file only append
+  FILE *out_file = open_file(argv[3], "wb");
+  if (out_file == NULL) {
+    fclose(in_file);
+    errx(EXIT_FAILURE, "err: failed to open file in write binary mode");
+  }
+  setvbuf(out_file, NULL, _IOFBF, FILE_BLOCK_BYTES);
+  fprintf(log, "file: open output: %s\n", argv[3]);
+
+
+  DEFER(fclose(in_file), fclose(out_file)) {
+    limb_dlist_t* ll = new_limb_list();
+
+    size_t bytes_read = read_file(ll, in_file);
+    if (bytes_read == __SIZE_MAX__) {
+      fprintf(log, "err: failed to read from file\n");
+      destroy_limb_list(ll);
+      break;
+    }
+    fprintf(log, "\nread: %zu bytes\n", bytes_read);
+
+    //print_limb_list(ll);
+
+    // Fingerprint the input now since encoding and decoding consume it
+    fingerprint_t expected_fp;
+    if (options->verify_primes != 0 && *argv[1] == 'e') {
+      fingerprint_value(&expected_fp, ll, options->verify_primes);
+    }
+    else if (options->verify_primes != 0) {
+      fingerprint_parity_vector(&expected_fp, ll, options->verify_primes);
+    }
+    
+    // Finished output limbs are written while the rest is computed,
+    // unless the output has to be verified before any of it is written
+    limb_stream_t* stream = NULL;
+    bool is_streamed = options->verify_primes == 0;
+
+    if (*argv[1] == 'e') {
+      collatz_cache_t* cache = NULL;
+      if (options->cache_path != NULL) {
+        cache = load_collatz_cache(options->cache_path);
+        if (cache == NULL) {
+          fprintf(log, "err: failed to load cache: %s\n", options->cache_path);
+          destroy_limb_list(ll);
+          break;
+        }
+        fprintf(log, "cache: loaded values below 2^%zu\n", cache->log2_bound);
+      }
+
+      if (is_streamed) stream = new_limb_stream(out_file);
+      collatz_encoder_t encoder = { cache, stream };
+
+      if (options->is_binary_radix) {
+        limb_dlist_t* buffer = ll;
+        ll = collatz_encode_pow2(buffer, &encoder);
+        destroy_limb_list(buffer);
+      }
+      else {
+        limb_dlist_t* buffer = new_limb_list();
+
+        to_radix_custom(buffer, ll);
+        destroy_limb_list(ll);
+        ll = collatz_encode_with(buffer, &encoder);
+        destroy_limb_list(buffer);
+      }
+
+      if (cache != NULL) destroy_collatz_cache(cache);
+    }
+    else if (*argv[1] == 'd' && options->is_binary_radix) {
+      limb_dlist_t* buffer = ll;
+      ll = collatz_decode_pow2(buffer);
+      destroy_limb_list(buffer);
+    }
+    else if (*argv[1] == 'd') {
+      limb_dlist_t* buffer = collatz_decode(ll);
+      if (is_streamed) stream = new_limb_stream(out_file);
+      to_radix_pow2_streamed(ll, buffer, stream);
+      destroy_limb_list(buffer);
+    }
+    else {
+      print_usage(argv[0]);
+      destroy_limb_list(ll);
+      break;
+    }
+    
+    canonicalize(ll);
+
+    if (options->verify_primes != 0) {
+      fingerprint_t actual_fp;
+      if (*argv[1] == 'e') {
+        fingerprint_parity_vector(&actual_fp, ll, options->verify_primes);
+      }
+      else {
+        fingerprint_value(&actual_fp, ll, options->verify_primes);
+      }
+
+      // Nothing has been written yet, so drop the empty output file
+      if (!is_eq_fingerprint(&expected_fp, &actual_fp)) {
+        if (!is_stdio_path(argv[3])) unlink(argv[3]);
+        errx(EXIT_FAILURE, "err: fingerprint mismatch, output does not round trip and was not written");
+      }
+      fprintf(log, "verify: fingerprints match modulo %zu primes\n", options->verify_primes);
+    }
+    
+    size_t bytes_write = stream != NULL
+      ? finish_limb_stream(stream, ll)
+      : write_file(ll, out_file);
+    if (bytes_write == __SIZE_MAX__) {
+      fprintf(log, "err: failed to write to file\n");
+      destroy_limb_list(ll);
+      break;
+    }
+
+    fprintf(log, "\nwrite: %zu bytes\n", bytes_write);
+
+    destroy_limb_list(ll);
+  }
+}
+
+int main(int argc, char* argv[]) {
+  load_collatz_tuning();
+
+  if (argc >= 2 && strcmp(argv[1], "range") == 0) {
+    return range_main(argc, argv);
+  }
+  if (argc >= 2 && strcmp(argv[1], "cache") == 0) {
+    return cache_main(argc, argv);
+  }
+  if (argc >= 2 && strcmp(argv[1], "serve") == 0) {
+    return serve_main(argc, argv);
+  }
+  if (argc >= 2 && strcmp(argv[1], "stats") == 0) {
+    return stats_main(argc, argv);
+  }
+  if (argc >= 2 && strcmp(argv[1], "verify") == 0) {
+    return verify_main(argc, argv);
+  }
+  if (argc == 2 && strcmp(argv[1], "bench") == 0) {
+    return bench_main();
+  }
+  if (argc >= 2 && strcmp(argv[1], "tune") == 0) {
+    return tune_main(argc, argv);
+  }
+
+  encode_options_t options;
+  if (argc < 2 || argc == 3 || !parse_encode_options(&options, argc, argv)) {
+    print_usage(argv[0]);
+    return 0;
+  }
+
+  if (argc == 2) {
+    if (*argv[1] == 't') {
+      test_convert();
+      test();
+      test_range();
+      test_range2();
+      test_sieve();
+      test_cache();
+      test_buffer();
+      test_serve();
+      test_limb_growth();
+      test_encode_pow2();
+      test_decode_pow2();
+      test_fingerprint();
+      test_stream();
+      test_tuning();
+      test_file_blocks();
+      test_stats();
+      test_radix_runs();
+    }
+    else {
+      print_usage(argv[0]);
+    }
+    return 0;
+  }
+  
+  FILE *log = is_stdio_path(argv[3]) ? stderr : stdout;
+  LOG_EXECUTION_TIME_TO(log, "Encoded in %f seconds\n") encode_main(argv, &options);
   
   return 0;
 }
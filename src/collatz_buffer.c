@@ -0,0 +1,108 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "collatz.h"
+#include "collatz_tuning.h"
+#include "limb_collatz.h"
+#include "limb_dlist.h"
+#include "limb_radix_common.h"
+
+struct collatz_workspace {
+  limb_dlist_t* input;
+  limb_dlist_t* buffer;
+  limb_dlist_t* output;
+};
+
+collatz_workspace_t* collatz_workspace_new(void) {
+  // Embedding programs get the host's profile like the CLI does
+  load_collatz_tuning();
+
+  collatz_workspace_t* ws = (collatz_workspace_t*) malloc(sizeof(collatz_workspace_t));
+  if (ws == NULL) return NULL;
+
+  ws->input = new_limb_list();
+  ws->buffer = new_limb_list();
+  ws->output = new_limb_list();
+  return ws;
+}
+
+void collatz_workspace_free(collatz_workspace_t* ws) {
+  if (ws == NULL) return;
+  destroy_limb_list(ws->input);
+  destroy_limb_list(ws->buffer);
+  destroy_limb_list(ws->output);
+  free(ws);
+}
+
+// Returns a read-only limb list over the input bytes. Aligned whole
+// limbs are viewed in place, anything else is copied into the workspace.
+// The in place view casts away const: callers may only shrink its
+// length, as canonicalize does, and must never write through the handle
+static limb_dlist_t* view_input(collatz_workspace_t* ws, limb_dlist_t* view,
+  const void* in, size_t in_len) {
+  bool is_aligned = ((uintptr_t) in % sizeof(limb_t)) == 0;
+  bool is_whole = (in_len % sizeof(limb_t)) == 0;
+
+  if (is_aligned && is_whole) {
+    view->length = in_len / sizeof(limb_t);
+    view->container_size = view->length;
+    view->handle = (limb_t*) (uintptr_t) in;
+    view->is_huge = false;
+    return view;
+  }
+
+  size_t length = (in_len + sizeof(limb_t) - 1u) / sizeof(limb_t);
+  resize_limb_list_to_length(ws->input, length);
+  ws->input->length = length;
+  if (length != 0) LL_TAIL(ws->input) = 0;
+  memcpy(ws->input->handle, in, in_len);
+  return ws->input;
+}
+
+// Same byte length rules as write_file: whole limbs followed
+// by the tail limb without its most significant zero bytes
+static size_t output_length(limb_dlist_t* ll) {
+  canonicalize(ll);
+  if (ll->length == 0) return __SIZE_MAX__;
+
+  size_t tail_bytes = 0;
+  for (limb_t tail = LL_TAIL(ll); tail != 0; tail >>= 8u) tail_bytes++;
+  return (ll->length - 1u) * sizeof(limb_t) + tail_bytes;
+}
+
+size_t collatz_encode_buffer(collatz_workspace_t* ws,
+  const void* in, size_t in_len, const unsigned char** out) {
+  limb_dlist_t view;
+  limb_dlist_t* input = view_input(ws, &view, in, in_len);
+
+  canonicalize(input);
+  if (input->length == 0) return __SIZE_MAX__;
+
+  // The encoder consumes its input, which must not be the caller's bytes
+  if (input == &view) {
+    copy_limb_list(ws->buffer, input);
+    input = ws->buffer;
+  }
+
+  // Encoding in the 2^64 radix the bytes are already in skips the
+  // quadratic conversion into the custom radix
+  collatz_encode_pow2_into(ws->output, input, NULL);
+
+  *out = (const unsigned char*) ws->output->handle;
+  return output_length(ws->output);
+}
+
+size_t collatz_decode_buffer(collatz_workspace_t* ws,
+  const void* in, size_t in_len, const unsigned char** out) {
+  limb_dlist_t view;
+  limb_dlist_t* input = view_input(ws, &view, in, in_len);
+
+  canonicalize(input);
+  if (input->length == 0) return __SIZE_MAX__;
+
+  // Decodes straight into the workspace, the input is only read
+  collatz_decode_pow2_into(ws->output, input);
+
+  *out = (const unsigned char*) ws->output->handle;
+  return output_length(ws->output);
+}
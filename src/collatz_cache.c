@@ -0,0 +1,185 @@
+#include <assert.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "collatz_cache.h"
+#include "collatz_tuning.h"
+
+typedef struct collatz_cache_header {
+  char magic[8];
+  limb_t version;
+  limb_t log2_bound;
+  limb_t pool_bits;
+} collatz_cache_header_t;
+
+#define POOL_WORDS(BITS) ((BITS) / LIMB_CONTAINER_BIT_LENGTH + 2u)
+
+static size_t cache_memory_size(limb_t bound, limb_t pool_bits) {
+  return sizeof(collatz_cache_header_t)
+    + sizeof(limb_t) * (bound + 1u)
+    + sizeof(limb_t) * POOL_WORDS(pool_bits);
+}
+
+static void attach_memory(collatz_cache_t* cache, void* memory, size_t memory_size) {
+  collatz_cache_header_t* header = (collatz_cache_header_t*) memory;
+  cache->log2_bound = header->log2_bound;
+  cache->bound = (limb_t) 1u << header->log2_bound;
+  cache->pool_bits = header->pool_bits;
+  cache->offsets = (const limb_t*) (header + 1);
+  cache->pool = cache->offsets + cache->bound + 1u;
+  cache->memory = memory;
+  cache->memory_size = memory_size;
+}
+
+// Every suffix has to lie within the pool for the word copies to
+// stay in bounds, so a truncated or corrupted file is rejected here
+static bool has_valid_offsets(const collatz_cache_t* cache) {
+  if (cache->offsets[0] != 0) return false;
+  for (limb_t x = 0; x < cache->bound; x++) {
+    if (cache->offsets[x] > cache->offsets[x + 1u]) return false;
+  }
+  return cache->offsets[cache->bound] <= cache->pool_bits;
+}
+
+// Number of parity bits needed to encode x, including the final bit for 1
+static limb_t suffix_length(limb_t x) {
+  wide_limb_t value = x;
+  limb_t length = 1;
+  while (value != 1u) {
+    value = (value % 2u == 0) ? value >> 1u : value + (value >> 1u) + 1u;
+    length++;
+  }
+  return length;
+}
+
+static void fill_suffix(limb_t* pool, limb_t x, limb_t bit_index) {
+  wide_limb_t value = x;
+  while (value != 1u) {
+    if (value % 2u == 0) {
+      value >>= 1u;
+    }
+    else {
+      value = value + (value >> 1u) + 1u;
+      // Neighbouring suffixes may share a word so set bits atomically
+      __atomic_fetch_or(&pool[bit_index / LIMB_CONTAINER_BIT_LENGTH],
+        (limb_t) 1u << (bit_index % LIMB_CONTAINER_BIT_LENGTH), __ATOMIC_RELAXED);
+    }
+    bit_index++;
+  }
+  __atomic_fetch_or(&pool[bit_index / LIMB_CONTAINER_BIT_LENGTH],
+    (limb_t) 1u << (bit_index % LIMB_CONTAINER_BIT_LENGTH), __ATOMIC_RELAXED);
+}
+
+collatz_cache_t* build_collatz_cache(size_t log2_bound) {
+  assert(log2_bound <= COLLATZ_CACHE_MAX_LOG2
+    && "err: cache bound too large");
+
+  limb_t bound = (limb_t) 1u << log2_bound;
+  limb_t* lengths = (limb_t*) malloc(sizeof(limb_t) * (bound + 1u));
+  assert(lengths != NULL && "oom: failed to allocate cache lengths");
+
+  // There does not exist a collatz encoding for 0
+  lengths[0] = 0;
+  #pragma omp parallel for num_threads(tuned_num_threads()) schedule(dynamic, 4096)
+  for (limb_t x = 1; x < bound; x++) {
+    lengths[x] = suffix_length(x);
+  }
+
+  // Exclusive prefix sum turns lengths into offsets in place
+  limb_t pool_bits = 0;
+  for (limb_t x = 0; x < bound; x++) {
+    limb_t length = lengths[x];
+    lengths[x] = pool_bits;
+    pool_bits += length;
+  }
+  lengths[bound] = pool_bits;
+
+  size_t memory_size = cache_memory_size(bound, pool_bits);
+  void* memory = calloc(1, memory_size);
+  assert(memory != NULL && "oom: failed to allocate cache memory");
+
+  collatz_cache_header_t* header = (collatz_cache_header_t*) memory;
+  memcpy(header->magic, COLLATZ_CACHE_MAGIC, sizeof(header->magic));
+  header->version = COLLATZ_CACHE_VERSION;
+  header->log2_bound = log2_bound;
+  header->pool_bits = pool_bits;
+
+  collatz_cache_t* cache = (collatz_cache_t*) malloc(sizeof(collatz_cache_t));
+  assert(cache != NULL && "oom: failed to allocate new cache");
+  attach_memory(cache, memory, memory_size);
+  cache->is_mapped = false;
+
+  limb_t* offsets = (limb_t*) cache->offsets;
+  limb_t* pool = (limb_t*) cache->pool;
+  memcpy(offsets, lengths, sizeof(limb_t) * (bound + 1u));
+  free(lengths);
+
+  #pragma omp parallel for num_threads(tuned_num_threads()) schedule(dynamic, 4096)
+  for (limb_t x = 1; x < bound; x++) {
+    fill_suffix(pool, x, offsets[x]);
+  }
+
+  return cache;
+}
+
+collatz_cache_t* load_collatz_cache(const char* path) {
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) return NULL;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(collatz_cache_header_t)) {
+    close(fd);
+    return NULL;
+  }
+
+  size_t memory_size = (size_t) st.st_size;
+  void* memory = mmap(NULL, memory_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (memory == MAP_FAILED) return NULL;
+
+  collatz_cache_header_t* header = (collatz_cache_header_t*) memory;
+  bool is_valid = memcmp(header->magic, COLLATZ_CACHE_MAGIC, sizeof(header->magic)) == 0
+    && header->version == COLLATZ_CACHE_VERSION
+    && header->log2_bound <= COLLATZ_CACHE_MAX_LOG2
+    && cache_memory_size((limb_t) 1u << header->log2_bound, header->pool_bits) == memory_size;
+
+  if (!is_valid) {
+    munmap(memory, memory_size);
+    return NULL;
+  }
+
+  collatz_cache_t* cache = (collatz_cache_t*) malloc(sizeof(collatz_cache_t));
+  assert(cache != NULL && "oom: failed to allocate new cache");
+  attach_memory(cache, memory, memory_size);
+  cache->is_mapped = true;
+
+  if (!has_valid_offsets(cache)) {
+    destroy_collatz_cache(cache);
+    return NULL;
+  }
+
+  // Suffixes are looked up in trajectory order, not file order
+  madvise(memory, memory_size, MADV_RANDOM);
+  return cache;
+}
+
+void destroy_collatz_cache(collatz_cache_t* cache) {
+  if (cache->is_mapped) {
+    munmap(cache->memory, cache->memory_size);
+  }
+  else {
+    free(cache->memory);
+  }
+  free(cache);
+}
+
+size_t write_collatz_cache(collatz_cache_t* cache, FILE* file) {
+  if (fwrite(cache->memory, 1, cache->memory_size, file) != cache->memory_size) {
+    return __SIZE_MAX__;
+  }
+  return cache->memory_size;
+}
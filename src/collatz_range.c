@@ -0,0 +1,168 @@
+#include <assert.h>
+#include <omp.h>
+
+#include "collatz_range.h"
+#include "collatz_tuning.h"
+#include "limb_dlist.h"
+#include "limb_radix_common.h"
+#include "limb_radix_custom.h"
+
+#define max(a,b) ((a) > (b) ? (a) : (b))
+#define min(a,b) ((a) < (b) ? (a) : (b))
+
+range_sieve_t* new_range_sieve(size_t log2_size) {
+  assert(log2_size <= RANGE_SIEVE_MAX_LOG2
+    && "err: sieve too large to fit coefficients in a limb");
+
+  range_sieve_t* sieve = (range_sieve_t*) malloc(sizeof(range_sieve_t));
+  assert(sieve != NULL && "oom: failed to allocate new sieve");
+
+  limb_t size = (limb_t) 1u << log2_size;
+  sieve->log2_size = log2_size;
+  sieve->length = 0;
+  sieve->residues = (limb_t*) malloc(sizeof(limb_t) * size);
+  sieve->pow3 = (limb_t*) malloc(sizeof(limb_t) * size);
+  sieve->offset = (limb_t*) malloc(sizeof(limb_t) * size);
+  assert(sieve->residues != NULL && sieve->pow3 != NULL && sieve->offset != NULL
+    && "oom: failed to allocate sieve residues");
+
+  for (limb_t r = 0; r < size; r++) {
+    // Track T^i(r) = (3^j r + d) / 2^i directly; while i < k the
+    // parity of T^i(r) equals the parity of T^i(2^k m + r)
+    limb_t value = r;
+    limb_t pow3 = 1;
+    limb_t pow2 = 1;
+    limb_t d = 0;
+    bool survives = true;
+
+    for (size_t i = 1; i <= log2_size; i++) {
+      if (value % 2u == 0) {
+        value /= 2u;
+      }
+      else {
+        d = 3u * d + pow2;
+        pow3 *= 3u;
+        value = value + value / 2u + 1u;
+      }
+      pow2 *= 2u;
+
+      if (pow3 < pow2 && max(r, 1u) * (pow2 - pow3) > d) {
+        survives = false;
+        break;
+      }
+    }
+
+    if (!survives) continue;
+    sieve->residues[sieve->length] = r;
+    sieve->pow3[sieve->length] = pow3;
+    sieve->offset[sieve->length] = value;
+    sieve->length++;
+  }
+
+  return sieve;
+}
+
+void destroy_range_sieve(range_sieve_t* sieve) {
+  free(sieve->residues);
+  free(sieve->pow3);
+  free(sieve->offset);
+  free(sieve);
+}
+
+// Slow path for trajectories that no longer fit in 128 bits.
+// Reaching 1 is a stronger property than dropping below n
+// so we only step until we hit 1
+static bool step_to_one_limb(wide_limb_t x, size_t steps) {
+  limb_dlist_t* ll = new_limb_list();
+  limb_dlist_t* ll_half = new_limb_list();
+
+  while (x != 0) {
+    resize_limb_list_to_length(ll, ll->length + 1);
+    insert_at_tail(ll, (limb_t) (x % LIMB_BASE));
+    x /= LIMB_BASE;
+  }
+
+  while (!is_eq_one(ll) && steps < RANGE_MAX_STEPS) {
+    if (is_even(ll)) {
+      right_shift(ll);
+    }
+    else {
+      copy_limb_list(ll_half, ll);
+      fused_increment_divide_by_two(ll_half);
+      add(ll, ll_half);
+    }
+    steps++;
+  }
+
+  bool reached_one = is_eq_one(ll);
+  destroy_limb_list(ll);
+  destroy_limb_list(ll_half);
+  return reached_one;
+}
+
+static bool drops_below_start(range_sieve_t* sieve, size_t index, limb_t block, limb_t n) {
+  // The first k steps are shared by the whole residue class
+  // so we can jump straight to T^k(n) = 3^j m + T^k(r)
+  wide_limb_t x = (wide_limb_t) sieve->pow3[index] * block + sieve->offset[index];
+  size_t steps = sieve->log2_size;
+
+  while (x >= n) {
+    if (steps++ >= RANGE_MAX_STEPS) return false;
+    if (x % 2u == 0) {
+      x >>= 1u;
+      continue;
+    }
+    // Guard against overflowing (3x + 1) / 2
+    if ((x >> 126u) != 0) return step_to_one_limb(x, steps);
+    x = x + (x >> 1u) + 1u;
+  }
+  return true;
+}
+
+range_result_t verify_range(range_sieve_t* sieve, limb_t start, limb_t end) {
+  range_result_t result = {0};
+  if (end <= start) return result;
+
+  size_t k = sieve->log2_size;
+  limb_t first_block = start >> k;
+  limb_t last_block = (end - 1u) >> k;
+  limb_t num_blocks = last_block - first_block + 1u;
+  size_t batch_size = get_collatz_tuning()->range_batch_size;
+  limb_t num_batches = (sieve->length + batch_size - 1u) / batch_size;
+
+  limb_t checked = 0;
+  limb_t failed = 0;
+  bool has_failed = false;
+
+  double start_time = omp_get_wtime();
+
+  #pragma omp parallel for num_threads(tuned_num_threads()) schedule(dynamic) reduction(+:checked)
+  for (limb_t item = 0; item < num_blocks * num_batches; item++) {
+    limb_t block = first_block + item / num_batches;
+    size_t batch_start = (size_t) (item % num_batches) * batch_size;
+    size_t batch_end = min(batch_start + batch_size, sieve->length);
+
+    for (size_t i = batch_start; i < batch_end; i++) {
+      limb_t n = (block << k) | sieve->residues[i];
+      if (n < start || n >= end) continue;
+      // 1 can never drop below itself, it is the end of the trajectory
+      if (n <= 1u) continue;
+
+      checked++;
+      if (drops_below_start(sieve, i, block, n)) continue;
+
+      #pragma omp critical
+      {
+        if (!has_failed || n < failed) failed = n;
+        has_failed = true;
+      }
+    }
+  }
+
+  result.count = end - start;
+  result.checked = checked;
+  result.failed = failed;
+  result.has_failed = has_failed;
+  result.seconds = omp_get_wtime() - start_time;
+  return result;
+}
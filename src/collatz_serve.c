@@ -0,0 +1,377 @@
+#include <assert.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "collatz.h"
+#include "collatz_serve.h"
+
+// A finished response waiting for the connection's writer
+typedef struct serve_output {
+  struct serve_output* next;
+  serve_response_header_t header;
+  unsigned char payload[];
+} serve_output_t;
+
+typedef struct serve_connection {
+  int in_fd;
+  int out_fd;
+  bool is_broken;
+  bool is_reading;
+  // Jobs pushed whose response has not been written yet
+  size_t pending;
+
+  // Responses are queued here by the workers and written out by the
+  // connection's own writer thread, so a client that stops reading
+  // only ever stalls itself
+  serve_output_t* head;
+  serve_output_t* tail;
+  size_t queued_bytes;
+
+  pthread_mutex_t lock;
+  pthread_cond_t has_output;
+  pthread_cond_t has_room;
+} serve_connection_t;
+
+typedef struct serve_job {
+  serve_connection_t* connection;
+  serve_request_header_t header;
+  void* payload;
+} serve_job_t;
+
+struct serve_pool {
+  size_t num_threads;
+  pthread_t* threads;
+
+  // Ring buffer of pending jobs, bounded by count and payload bytes
+  serve_job_t jobs[SERVE_QUEUE_CAPACITY];
+  size_t head;
+  size_t length;
+  size_t queued_bytes;
+  bool is_stopping;
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty;
+  pthread_cond_t not_full;
+};
+
+_Static_assert(SERVE_MAX_REQUEST_LENGTH <= SERVE_QUEUE_MAX_BYTES,
+  "a single request must fit in the job queue");
+
+static bool read_full(int fd, void* buffer, size_t length) {
+  unsigned char* bytes = (unsigned char*) buffer;
+  while (length != 0) {
+    ssize_t n = read(fd, bytes, length);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    bytes += n;
+    length -= (size_t) n;
+  }
+  return true;
+}
+
+static bool write_full(int fd, const void* buffer, size_t length) {
+  const unsigned char* bytes = (const unsigned char*) buffer;
+  while (length != 0) {
+    ssize_t n = write(fd, bytes, length);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    bytes += n;
+    length -= (size_t) n;
+  }
+  return true;
+}
+
+static void push_job(serve_pool_t* pool, serve_job_t job) {
+  pthread_mutex_lock(&pool->lock);
+  // Back-pressure: stop reading the connection until workers catch up
+  while (pool->length == SERVE_QUEUE_CAPACITY
+    || pool->queued_bytes + job.header.length > SERVE_QUEUE_MAX_BYTES) {
+    pthread_cond_wait(&pool->not_full, &pool->lock);
+  }
+  pool->jobs[(pool->head + pool->length) % SERVE_QUEUE_CAPACITY] = job;
+  pool->length++;
+  pool->queued_bytes += job.header.length;
+  pthread_cond_signal(&pool->not_empty);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+static bool pop_job(serve_pool_t* pool, serve_job_t* job) {
+  pthread_mutex_lock(&pool->lock);
+  while (pool->length == 0 && !pool->is_stopping) {
+    pthread_cond_wait(&pool->not_empty, &pool->lock);
+  }
+  if (pool->length == 0) {
+    pthread_mutex_unlock(&pool->lock);
+    return false;
+  }
+  *job = pool->jobs[pool->head];
+  pool->head = (pool->head + 1u) % SERVE_QUEUE_CAPACITY;
+  pool->length--;
+  pool->queued_bytes -= job->header.length;
+  // Readers wait on different sizes so wake all of them
+  pthread_cond_broadcast(&pool->not_full);
+  pthread_mutex_unlock(&pool->lock);
+  return true;
+}
+
+// Copies the response out of the workspace and hands it to the
+// connection's writer, never touching the socket itself
+static void respond(serve_connection_t* connection, serve_response_header_t* header, const void* payload) {
+  serve_output_t* output = (serve_output_t*) malloc(sizeof(serve_output_t) + header->length);
+  assert(output != NULL && "oom: failed to allocate serve response");
+  output->next = NULL;
+  output->header = *header;
+  if (header->length != 0) memcpy(output->payload, payload, header->length);
+
+  pthread_mutex_lock(&connection->lock);
+  if (connection->tail != NULL) connection->tail->next = output;
+  else connection->head = output;
+  connection->tail = output;
+  connection->queued_bytes += header->length;
+  pthread_cond_signal(&connection->has_output);
+  pthread_mutex_unlock(&connection->lock);
+}
+
+static void* writer_main(void* arg) {
+  serve_connection_t* connection = (serve_connection_t*) arg;
+
+  pthread_mutex_lock(&connection->lock);
+  while (true) {
+    while (connection->head == NULL && (connection->is_reading || connection->pending != 0)) {
+      pthread_cond_wait(&connection->has_output, &connection->lock);
+    }
+    serve_output_t* output = connection->head;
+    if (output == NULL) break;
+
+    connection->head = output->next;
+    if (connection->head == NULL) connection->tail = NULL;
+    bool is_broken = connection->is_broken;
+    pthread_mutex_unlock(&connection->lock);
+
+    // Once a write fails the rest of the responses are only dropped
+    if (!is_broken) {
+      is_broken = !write_full(connection->out_fd, &output->header, sizeof(output->header))
+        || !write_full(connection->out_fd, output->payload, output->header.length);
+    }
+
+    pthread_mutex_lock(&connection->lock);
+    connection->is_broken = is_broken;
+    connection->queued_bytes -= output->header.length;
+    connection->pending--;
+    pthread_cond_signal(&connection->has_room);
+    free(output);
+  }
+  pthread_mutex_unlock(&connection->lock);
+  return NULL;
+}
+
+static void* worker_main(void* arg) {
+  serve_pool_t* pool = (serve_pool_t*) arg;
+
+  // Kept for the lifetime of the worker so its buffers stay warm
+  collatz_workspace_t* ws = collatz_workspace_new();
+  assert(ws != NULL && "oom: failed to allocate worker workspace");
+
+  serve_job_t job;
+  while (pop_job(pool, &job)) {
+    serve_response_header_t header = { SERVE_STATUS_OK, 0, job.header.id, 0 };
+    const unsigned char* out = NULL;
+    size_t out_len = __SIZE_MAX__;
+
+    if (job.header.op == SERVE_OP_ENCODE) {
+      out_len = collatz_encode_buffer(ws, job.payload, job.header.length, &out);
+    }
+    else if (job.header.op == SERVE_OP_DECODE) {
+      out_len = collatz_decode_buffer(ws, job.payload, job.header.length, &out);
+    }
+    else {
+      header.status = SERVE_STATUS_BAD_OP;
+    }
+
+    if (header.status == SERVE_STATUS_OK && out_len == __SIZE_MAX__) {
+      header.status = SERVE_STATUS_ZERO;
+    }
+    if (header.status == SERVE_STATUS_OK) {
+      header.length = out_len;
+    }
+
+    respond(job.connection, &header, out);
+    free(job.payload);
+  }
+
+  collatz_workspace_free(ws);
+  return NULL;
+}
+
+serve_pool_t* new_serve_pool(size_t num_threads) {
+  serve_pool_t* pool = (serve_pool_t*) malloc(sizeof(serve_pool_t));
+  assert(pool != NULL && "oom: failed to allocate serve pool");
+
+  pool->num_threads = num_threads;
+  pool->threads = (pthread_t*) malloc(sizeof(pthread_t) * num_threads);
+  assert(pool->threads != NULL && "oom: failed to allocate serve threads");
+  pool->head = 0;
+  pool->length = 0;
+  pool->queued_bytes = 0;
+  pool->is_stopping = false;
+  pthread_mutex_init(&pool->lock, NULL);
+  pthread_cond_init(&pool->not_empty, NULL);
+  pthread_cond_init(&pool->not_full, NULL);
+
+  for (size_t i = 0; i < num_threads; i++) {
+    int err = pthread_create(&pool->threads[i], NULL, worker_main, pool);
+    assert(err == 0 && "err: failed to start serve worker");
+    (void) err;
+  }
+  return pool;
+}
+
+void destroy_serve_pool(serve_pool_t* pool) {
+  pthread_mutex_lock(&pool->lock);
+  pool->is_stopping = true;
+  pthread_cond_broadcast(&pool->not_empty);
+  pthread_mutex_unlock(&pool->lock);
+
+  for (size_t i = 0; i < pool->num_threads; i++) {
+    pthread_join(pool->threads[i], NULL);
+  }
+
+  pthread_mutex_destroy(&pool->lock);
+  pthread_cond_destroy(&pool->not_empty);
+  pthread_cond_destroy(&pool->not_full);
+  free(pool->threads);
+  free(pool);
+}
+
+void serve_connection(serve_pool_t* pool, int in_fd, int out_fd) {
+  serve_connection_t connection;
+  connection.in_fd = in_fd;
+  connection.out_fd = out_fd;
+  connection.is_broken = false;
+  connection.is_reading = true;
+  connection.pending = 0;
+  connection.head = NULL;
+  connection.tail = NULL;
+  connection.queued_bytes = 0;
+  pthread_mutex_init(&connection.lock, NULL);
+  pthread_cond_init(&connection.has_output, NULL);
+  pthread_cond_init(&connection.has_room, NULL);
+
+  pthread_t writer;
+  int err = pthread_create(&writer, NULL, writer_main, &connection);
+  assert(err == 0 && "err: failed to start serve writer");
+  (void) err;
+
+  serve_job_t job;
+  job.connection = &connection;
+
+  while (read_full(in_fd, &job.header, sizeof(job.header))) {
+    if (job.header.length > SERVE_MAX_REQUEST_LENGTH) break;
+
+    // malloc alignment lets aligned payloads be used in place as limbs
+    job.payload = malloc(job.header.length == 0 ? 1u : job.header.length);
+    if (job.payload == NULL) break;
+    if (!read_full(in_fd, job.payload, job.header.length)) {
+      free(job.payload);
+      break;
+    }
+
+    // Back-pressure: stop reading while the client is not taking its
+    // responses so their memory stays bounded
+    pthread_mutex_lock(&connection.lock);
+    while (!connection.is_broken && connection.queued_bytes >= SERVE_MAX_PENDING_BYTES) {
+      pthread_cond_wait(&connection.has_room, &connection.lock);
+    }
+    bool is_broken = connection.is_broken;
+    if (!is_broken) connection.pending++;
+    pthread_mutex_unlock(&connection.lock);
+
+    if (is_broken) {
+      free(job.payload);
+      break;
+    }
+    push_job(pool, job);
+  }
+
+  // Responses reference the connection so wait until they are written
+  pthread_mutex_lock(&connection.lock);
+  connection.is_reading = false;
+  pthread_cond_signal(&connection.has_output);
+  pthread_mutex_unlock(&connection.lock);
+  pthread_join(writer, NULL);
+
+  pthread_mutex_destroy(&connection.lock);
+  pthread_cond_destroy(&connection.has_output);
+  pthread_cond_destroy(&connection.has_room);
+}
+
+typedef struct serve_socket_args {
+  serve_pool_t* pool;
+  int fd;
+} serve_socket_args_t;
+
+static void* socket_reader_main(void* arg) {
+  serve_socket_args_t args = *(serve_socket_args_t*) arg;
+  free(arg);
+
+  serve_connection(args.pool, args.fd, args.fd);
+  close(args.fd);
+  return NULL;
+}
+
+bool serve_unix_socket(serve_pool_t* pool, const char* path) {
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(addr.sun_path)) return false;
+  strcpy(addr.sun_path, path);
+
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listen_fd < 0) return false;
+
+  // Only a stale socket from an earlier run may be replaced,
+  // anything else at the path is left alone
+  struct stat st;
+  if (lstat(path, &st) == 0) {
+    if (!S_ISSOCK(st.st_mode)) {
+      close(listen_fd);
+      errno = EADDRINUSE;
+      return false;
+    }
+    unlink(path);
+  }
+
+  if (bind(listen_fd, (struct sockaddr*) &addr, sizeof(addr)) != 0
+    || listen(listen_fd, SERVE_LISTEN_BACKLOG) != 0) {
+    close(listen_fd);
+    return false;
+  }
+
+  while (true) {
+    int fd = accept(listen_fd, NULL, NULL);
+    if (fd < 0 && errno == EINTR) continue;
+    if (fd < 0) break;
+
+    serve_socket_args_t* args = (serve_socket_args_t*) malloc(sizeof(serve_socket_args_t));
+    assert(args != NULL && "oom: failed to allocate connection");
+    args->pool = pool;
+    args->fd = fd;
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, socket_reader_main, args) != 0) {
+      free(args);
+      close(fd);
+      continue;
+    }
+    pthread_detach(thread);
+  }
+
+  close(listen_fd);
+  return false;
+}
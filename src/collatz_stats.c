@@ -0,0 +1,139 @@
+#include <omp.h>
+
+#include "collatz_stats.h"
+#include "collatz_tuning.h"
+#include "limb_radix_common.h"
+#include "limb_radix_pow2.h"
+
+static size_t wide_bit_length(wide_limb_t x) {
+  limb_t high = (limb_t) (x >> LIMB_CONTAINER_BIT_LENGTH);
+  limb_t low = (limb_t) x;
+  if (high != 0) return 2u * LIMB_CONTAINER_BIT_LENGTH - (size_t) __builtin_clzll(high);
+  if (low != 0) return LIMB_CONTAINER_BIT_LENGTH - (size_t) __builtin_clzll(low);
+  return 0;
+}
+
+static bool is_less_pow2(limb_dlist_t* a, limb_dlist_t* b) {
+  canonicalize(a);
+  canonicalize(b);
+  if (a->length != b->length) return a->length < b->length;
+
+  for (size_t i = a->length - 1; i != __SIZE_MAX__; i--) {
+    if (LL_INDEX(a, i) != LL_INDEX(b, i)) return LL_INDEX(a, i) < LL_INDEX(b, i);
+  }
+  return false;
+}
+
+// Steps ll in the plain 2^64 radix until it reaches 1, adding on to
+// the counters in `stats`. `start` is only compared against.
+static void step_pow2(limb_dlist_t* ll, limb_dlist_t* start, collatz_stats_t* stats) {
+  while (true) {
+    // A run of even steps is a single shift
+    size_t zeros = pow2_count_trailing_zeros(ll);
+    if (zeros != 0) {
+      size_t shifted = 0;
+
+      if (stats->drop_step == 0) {
+        // Halving can only drop below start once the bit lengths match,
+        // so shift up to there and the drop is that step or the next
+        size_t ll_bits = get_bit_length(ll);
+        size_t start_bits = get_bit_length(start);
+        size_t until_equal = ll_bits > start_bits ? ll_bits - start_bits : 0;
+
+        if (until_equal <= zeros) {
+          if (until_equal != 0) pow2_right_shift_by(ll, until_equal);
+          shifted = until_equal;
+          if (is_less_pow2(ll, start)) stats->drop_step = stats->steps + shifted;
+          else if (shifted < zeros) stats->drop_step = stats->steps + shifted + 1u;
+        }
+      }
+
+      if (zeros != shifted) pow2_right_shift_by(ll, zeros - shifted);
+      stats->steps += zeros;
+    }
+
+    if (is_eq_one(ll)) break;
+
+    // An odd step always grows the value so it can not drop here
+    pow2_fused_multiply_by_three_increment_halve(ll);
+    stats->steps++;
+    stats->odd_steps++;
+
+    size_t bits = get_bit_length(ll);
+    if (bits > stats->peak_bits) stats->peak_bits = bits;
+  }
+}
+
+// Slow path for trajectories that no longer fit in 128 bits
+static void step_pow2_from_wide(wide_limb_t x, limb_t n, collatz_stats_t* stats) {
+  limb_dlist_t* ll = new_limb_list();
+  limb_dlist_t* start = new_limb_list();
+
+  resize_limb_list_to_length(ll, 2);
+  insert_at_tail(ll, (limb_t) x);
+  insert_at_tail(ll, (limb_t) (x >> LIMB_CONTAINER_BIT_LENGTH));
+  resize_limb_list_to_length(start, 1);
+  insert_at_tail(start, n);
+
+  step_pow2(ll, start, stats);
+
+  destroy_limb_list(ll);
+  destroy_limb_list(start);
+}
+
+collatz_stats_t collatz_stats_value(limb_t n) {
+  collatz_stats_t stats = {0};
+
+  // There does not exist a collatz encoding for 0
+  if (n == 0) return stats;
+
+  wide_limb_t x = n;
+  wide_limb_t peak = n;
+
+  while (x != 1u) {
+    if (x % 2u == 0) {
+      x >>= 1u;
+    }
+    else {
+      // Guard against overflowing (3x + 1) / 2
+      if ((x >> 126u) != 0) {
+        stats.peak_bits = wide_bit_length(peak);
+        step_pow2_from_wide(x, n, &stats);
+        return stats;
+      }
+      x = x + (x >> 1u) + 1u;
+      stats.odd_steps++;
+      if (x > peak) peak = x;
+    }
+
+    stats.steps++;
+    if (stats.drop_step == 0 && x < n) stats.drop_step = stats.steps;
+  }
+
+  stats.peak_bits = wide_bit_length(peak);
+  return stats;
+}
+
+void collatz_stats_batch(const limb_t* values, size_t count, collatz_stats_t* out) {
+  #pragma omp parallel for num_threads(tuned_num_threads()) schedule(dynamic, 256)
+  for (size_t i = 0; i < count; i++) {
+    out[i] = collatz_stats_value(values[i]);
+  }
+}
+
+collatz_stats_t collatz_stats_pow2(limb_dlist_t* ll) {
+  collatz_stats_t stats = {0};
+
+  // There does not exist a collatz encoding for 0
+  canonicalize(ll);
+  if (ll->length == 0) return stats;
+
+  limb_dlist_t* start = new_limb_list();
+  copy_limb_list(start, ll);
+  stats.peak_bits = get_bit_length(ll);
+
+  step_pow2(ll, start, &stats);
+
+  destroy_limb_list(start);
+  return stats;
+}
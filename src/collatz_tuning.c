@@ -0,0 +1,160 @@
+#include <omp.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "collatz_range.h"
+#include "collatz_tuning.h"
+#include "collatz_verify.h"
+#include "limb_collatz_fixed.h"
+#include "limb_dlist.h"
+
+#define IS_POWER_OF_TWO(N) (((N) & ((N) - 1u)) == 0u)
+
+typedef struct tuning_key {
+  const char* name;
+  size_t offset;
+} tuning_key_t;
+
+static const tuning_key_t keys[] = {
+  { "threads", offsetof(collatz_tuning_t, threads) },
+  { "initial_limbs", offsetof(collatz_tuning_t, initial_limbs) },
+  { "huge_page_threshold", offsetof(collatz_tuning_t, huge_page_threshold) },
+  { "fixed_max_limbs", offsetof(collatz_tuning_t, fixed_max_limbs) },
+  { "fixed_chunk_steps", offsetof(collatz_tuning_t, fixed_chunk_steps) },
+  { "range_batch_size", offsetof(collatz_tuning_t, range_batch_size) },
+  { "verify_segment_bits", offsetof(collatz_tuning_t, verify_segment_bits) },
+};
+
+#define NUM_KEYS (sizeof(keys) / sizeof(keys[0]))
+#define KEY_FIELD(TUNING, KEY) ((size_t*) ((char*) (TUNING) + (KEY)->offset))
+
+// Compiled in defaults until a profile is loaded or set
+static collatz_tuning_t active_tuning = {
+  .threads = 0,
+  .initial_limbs = LL_INITIAL_SIZE,
+  .huge_page_threshold = LL_HUGE_PAGE_THRESHOLD,
+  .fixed_max_limbs = FIXED_MAX_LIMBS,
+  .fixed_chunk_steps = FIXED_CHUNK_STEPS,
+  .range_batch_size = RANGE_BATCH_SIZE,
+  .verify_segment_bits = VERIFY_SEGMENT_BITS,
+};
+
+void default_collatz_tuning(collatz_tuning_t* tuning) {
+  tuning->threads = 0;
+  tuning->initial_limbs = LL_INITIAL_SIZE;
+  tuning->huge_page_threshold = LL_HUGE_PAGE_THRESHOLD;
+  tuning->fixed_max_limbs = FIXED_MAX_LIMBS;
+  tuning->fixed_chunk_steps = FIXED_CHUNK_STEPS;
+  tuning->range_batch_size = RANGE_BATCH_SIZE;
+  tuning->verify_segment_bits = VERIFY_SEGMENT_BITS;
+}
+
+static bool is_valid_tuning(const collatz_tuning_t* tuning) {
+  if (tuning->initial_limbs == 0 || !IS_POWER_OF_TWO(tuning->initial_limbs)) return false;
+  // Huge mappings are trimmed to whole huge pages
+  if (tuning->huge_page_threshold < LL_HUGE_PAGE_SIZE) return false;
+  if (tuning->fixed_max_limbs > FIXED_MAX_LIMBS) return false;
+  if (tuning->fixed_chunk_steps == 0) return false;
+  if (tuning->range_batch_size == 0) return false;
+  if (tuning->verify_segment_bits == 0) return false;
+  return true;
+}
+
+const collatz_tuning_t* get_collatz_tuning() {
+  return &active_tuning;
+}
+
+void set_collatz_tuning(const collatz_tuning_t* tuning) {
+  active_tuning = *tuning;
+  // Callers insert a handful of limbs into a new list without resizing
+  if (active_tuning.initial_limbs < LL_INITIAL_SIZE) active_tuning.initial_limbs = LL_INITIAL_SIZE;
+  set_limb_list_tuning(active_tuning.initial_limbs, active_tuning.huge_page_threshold);
+}
+
+static pthread_once_t load_once = PTHREAD_ONCE_INIT;
+
+static void load_profile() {
+  char path[4096];
+  if (collatz_tuning_path(path, sizeof(path)) == NULL) return;
+
+  FILE *file = fopen(path, "r");
+  if (file == NULL) return;
+
+  collatz_tuning_t tuning;
+  default_collatz_tuning(&tuning);
+  size_t num_read = read_collatz_tuning(&tuning, file);
+  fclose(file);
+
+  if (num_read == __SIZE_MAX__) {
+    fprintf(stderr, "tuning: ignoring malformed profile %s\n", path);
+    return;
+  }
+  set_collatz_tuning(&tuning);
+}
+
+void load_collatz_tuning() {
+  pthread_once(&load_once, load_profile);
+}
+
+size_t read_collatz_tuning(collatz_tuning_t* tuning, FILE *file) {
+  collatz_tuning_t parsed = *tuning;
+  size_t num_read = 0;
+  char line[TUNING_MAX_LINE];
+
+  while (fgets(line, sizeof(line), file) != NULL) {
+    line[strcspn(line, "#\r\n")] = '\0';
+
+    char* key = line + strspn(line, " \t");
+    if (*key == '\0') continue;
+
+    char* value = strchr(key, '=');
+    if (value == NULL) return __SIZE_MAX__;
+    *value++ = '\0';
+    key[strcspn(key, " \t")] = '\0';
+
+    char* end;
+    size_t parsed_value = strtoull(value, &end, 0);
+    if (end == value || end[strspn(end, " \t")] != '\0') return __SIZE_MAX__;
+
+    size_t k = 0;
+    while (k < NUM_KEYS && strcmp(keys[k].name, key) != 0) k++;
+    if (k == NUM_KEYS) return __SIZE_MAX__;
+
+    *KEY_FIELD(&parsed, &keys[k]) = parsed_value;
+    num_read++;
+  }
+
+  if (ferror(file) || !is_valid_tuning(&parsed)) return __SIZE_MAX__;
+  *tuning = parsed;
+  return num_read;
+}
+
+size_t write_collatz_tuning(const collatz_tuning_t* tuning, FILE *file) {
+  size_t bytes_write = 0;
+  for (size_t k = 0; k < NUM_KEYS; k++) {
+    int length = fprintf(file, "%s=%zu\n", keys[k].name, *KEY_FIELD(tuning, &keys[k]));
+    if (length < 0) return __SIZE_MAX__;
+    bytes_write += (size_t) length;
+  }
+  return bytes_write;
+}
+
+const char* collatz_tuning_path(char* path, size_t path_size) {
+  const char* env_path = getenv(TUNING_PATH_ENV);
+  if (env_path != NULL && *env_path != '\0') {
+    snprintf(path, path_size, "%s", env_path);
+    return path;
+  }
+
+  const char* home = getenv("HOME");
+  if (home == NULL || *home == '\0') return NULL;
+  snprintf(path, path_size, "%s/%s", home, TUNING_DEFAULT_FILE);
+  return path;
+}
+
+int tuned_num_threads() {
+  size_t threads = get_collatz_tuning()->threads;
+  return threads != 0 ? (int) threads : omp_get_max_threads();
+}
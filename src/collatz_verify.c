@@ -0,0 +1,120 @@
+#include <assert.h>
+
+#include "collatz_tuning.h"
+#include "collatz_verify.h"
+#include "limb_radix_common.h"
+#include "limb_radix_pow2.h"
+
+// The largest primes below 2^61 so that 2x + 2p still fits in a limb
+static const limb_t primes[VERIFY_MAX_PRIMES] = {
+  0x1fffffffffffffffull,
+  0x1fffffffffffffe1ull,
+  0x1fffffffffffffd3ull,
+  0x1fffffffffffff1bull,
+  0x1ffffffffffffefdull,
+  0x1ffffffffffffee5ull,
+  0x1ffffffffffffeadull,
+  0x1ffffffffffffe79ull,
+};
+
+// x -> a x + b mod p
+typedef struct affine_map {
+  limb_t a;
+  limb_t b;
+} affine_map_t;
+
+static inline limb_t double_mod(limb_t x, limb_t p) {
+  x <<= 1u;
+  return x >= p ? x - p : x;
+}
+
+static inline limb_t decrement_mod(limb_t x, limb_t p) {
+  return x == 0 ? p - 1u : x - 1u;
+}
+
+// x / 3 mod p without a multiplication: add the multiple of p
+// that makes x divisible by 3 and divide exactly
+static inline limb_t divide_by_three_mod(limb_t x, limb_t p) {
+  limb_t k = (3u - (x % 3u) * (p % 3u) % 3u) % 3u;
+  return (x + k * p) / 3u;
+}
+
+static inline limb_t multiply_mod(limb_t a, limb_t b, limb_t p) {
+  return (limb_t) (((wide_limb_t) a * b) % p);
+}
+
+static affine_map_t reduce_segment(limb_dlist_t* ll, size_t lo, size_t hi, limb_t p) {
+  affine_map_t map = { 1, 0 };
+
+  // Bits are applied from most to least significant
+  for (size_t i = hi - 1; i != lo - 1; i--) {
+    map.a = double_mod(map.a, p);
+    map.b = double_mod(map.b, p);
+
+    if (get_ith_bit(ll, i) != 0) {
+      map.a = divide_by_three_mod(map.a, p);
+      map.b = divide_by_three_mod(decrement_mod(map.b, p), p);
+    }
+  }
+  return map;
+}
+
+void fingerprint_value(fingerprint_t* fp, limb_dlist_t* ll, size_t num_primes) {
+  assert(num_primes <= VERIFY_MAX_PRIMES && "err: too many fingerprint primes");
+  canonicalize(ll);
+  fp->num_primes = num_primes;
+
+  for (size_t j = 0; j < num_primes; j++) {
+    limb_t p = primes[j];
+    limb_t residue = 0;
+    for (size_t i = ll->length - 1; i != __SIZE_MAX__; i--) {
+      wide_limb_t shifted = ((wide_limb_t) residue << LIMB_CONTAINER_BIT_LENGTH) | LL_INDEX(ll, i);
+      residue = (limb_t) (shifted % p);
+    }
+    fp->residues[j] = residue;
+  }
+}
+
+void fingerprint_parity_vector(fingerprint_t* fp, limb_dlist_t* ll, size_t num_primes) {
+  assert(num_primes <= VERIFY_MAX_PRIMES && "err: too many fingerprint primes");
+  fp->num_primes = num_primes;
+
+  // There does not exist a collatz encoding for 0, it decodes to 1
+  size_t bit_length = get_bit_length(ll);
+  size_t num_bits = bit_length == 0 ? 0 : bit_length - 1u;
+  size_t segment_bits = get_collatz_tuning()->verify_segment_bits;
+  size_t num_segments = (num_bits + segment_bits - 1u) / segment_bits;
+
+  affine_map_t* maps = (affine_map_t*) malloc(sizeof(affine_map_t) * (num_segments * num_primes + 1u));
+  assert(maps != NULL && "oom: failed to allocate fingerprint segments");
+
+  #pragma omp parallel for num_threads(tuned_num_threads()) collapse(2) schedule(dynamic)
+  for (size_t s = 0; s < num_segments; s++) {
+    for (size_t j = 0; j < num_primes; j++) {
+      size_t lo = s * segment_bits;
+      size_t hi = lo + segment_bits < num_bits ? lo + segment_bits : num_bits;
+      maps[s * num_primes + j] = reduce_segment(ll, lo, hi, primes[j]);
+    }
+  }
+
+  // Decoding starts at 1 and works down from the most significant segment
+  for (size_t j = 0; j < num_primes; j++) {
+    limb_t p = primes[j];
+    limb_t x = 1;
+    for (size_t s = num_segments - 1; s != __SIZE_MAX__; s--) {
+      affine_map_t map = maps[s * num_primes + j];
+      x = (multiply_mod(map.a, x, p) + map.b) % p;
+    }
+    fp->residues[j] = x;
+  }
+
+  free(maps);
+}
+
+bool is_eq_fingerprint(fingerprint_t* a, fingerprint_t* b) {
+  if (a->num_primes != b->num_primes) return false;
+  for (size_t j = 0; j < a->num_primes; j++) {
+    if (a->residues[j] != b->residues[j]) return false;
+  }
+  return true;
+}
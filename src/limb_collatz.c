@@ -3,42 +3,122 @@
 #include "limb_radix_custom.h"
 #include "limb_radix_pow2.h"
 #include "limb_collatz.h"
+#include "limb_collatz_fixed.h"
+
+// A single limb value is the same in any radix so it can
+// index the cache directly once it is below the bound
+static bool append_cached_suffix(limb_dlist_t* result, size_t i,
+  limb_dlist_t* ll, const collatz_cache_t* cache) {
+  if (cache == NULL || ll->length != 1 || LL_HEAD(ll) >= cache->bound) return false;
+
+  limb_t offset = cache->offsets[LL_HEAD(ll)];
+  limb_t length = cache->offsets[LL_HEAD(ll) + 1] - offset;
+  append_bits(result, i, cache->pool, offset, length);
+  return true;
+}
 
 limb_dlist_t* collatz_encode(limb_dlist_t* ll) {
+  return collatz_encode_with(ll, NULL);
+}
+
+limb_dlist_t* collatz_encode_with(limb_dlist_t* ll, const collatz_encoder_t* encoder) {
   limb_dlist_t* result = new_limb_list();
-  limb_dlist_t* ll_half = new_limb_list();
+  collatz_encode_into(result, ll, encoder);
+  return result;
+}
+
+void collatz_encode_into(limb_dlist_t* result, limb_dlist_t* ll, const collatz_encoder_t* encoder) {
+  const collatz_cache_t* cache = encoder != NULL ? encoder->cache : NULL;
+  limb_stream_t* stream = encoder != NULL ? encoder->stream : NULL;
   size_t i = 0;
+
+  // Bits are only ever or'ed in after padding with zero limbs,
+  // so emptying the list is enough to reuse its container
+  result->length = 0;
   
   // There does not exist a collatz encoding for 0
   // so we must check if its equal to zero
   canonicalize(ll);
   if (ll->length == 0) {
-    destroy_limb_list(ll_half);
-    return result;
+    return;
   }
 
+  // Small values hand back to this loop once they drop below the
+  // cache bound so the cache can take over
+  limb_t stop_below = cache != NULL ? cache->bound : 2u;
+
   while (!is_eq_one(ll)) {
+    if (append_cached_suffix(result, i, ll, cache)) return;
+
+    size_t steps = collatz_encode_fixed(ll, result, i, stop_below);
+    if (steps != 0) {
+      i += steps;
+      stream_finished_bits(stream, result, i);
+      continue;
+    }
+
     if (is_even(ll)) {
-      // x / 2
-      right_shift(ll);
+      // x / 2^k for the whole run of even steps the base allows
+      size_t k = even_run_length(ll);
+      if (k == 1) right_shift(ll);
+      else right_shift_by(ll, k);
+      i += k;
     }
     else {
-      // (3 x + 1) / 2 = x + (x + 1) / 2 = x + ((x + 1) >> 1)
-      // since x is odd: = x + (x >> 1) + 1 also works
-      copy_limb_list(ll_half, ll);
-      
-      // let's use optimized: x + ((x + 1) >> 1)
-      fused_increment_divide_by_two(ll_half);
-      add(ll, ll_half);
-      set_ith_bit(result, i);
+      // (3 x + 1) / 2 = x + (x + 1) / 2 in a single sweep, or a run
+      // of k odd steps as 3^k floor(x / 2^k) + 3^k - 1
+      size_t k = odd_run_length(ll);
+      if (k == 1) fused_multiply_by_three_increment_halve(ll);
+      else fused_odd_steps(ll, k);
+      for (size_t j = 0; j < k; j++) set_ith_bit(result, i + j);
+      i += k;
     }
-    i++;
+    stream_finished_bits(stream, result, i);
   }
   set_ith_bit(result, i);
-  destroy_limb_list(ll_half);
+}
+
+limb_dlist_t* collatz_encode_pow2(limb_dlist_t* ll, const collatz_encoder_t* encoder) {
+  limb_dlist_t* result = new_limb_list();
+  collatz_encode_pow2_into(result, ll, encoder);
   return result;
 }
 
+void collatz_encode_pow2_into(limb_dlist_t* result, limb_dlist_t* ll, const collatz_encoder_t* encoder) {
+  const collatz_cache_t* cache = encoder != NULL ? encoder->cache : NULL;
+  limb_stream_t* stream = encoder != NULL ? encoder->stream : NULL;
+  size_t i = 0;
+
+  // Bits are only ever or'ed in after padding with zero limbs,
+  // so emptying the list is enough to reuse its container
+  result->length = 0;
+
+  // There does not exist a collatz encoding for 0
+  // so we must check if its equal to zero
+  canonicalize(ll);
+  if (ll->length == 0) {
+    return;
+  }
+
+  while (true) {
+    // A run of even steps only adds zero bits so skip it in one go
+    size_t zeros = pow2_count_trailing_zeros(ll);
+    if (zeros != 0) {
+      pow2_right_shift_by(ll, zeros);
+      i += zeros;
+    }
+
+    if (is_eq_one(ll)) break;
+    if (append_cached_suffix(result, i, ll, cache)) return;
+
+    pow2_fused_multiply_by_three_increment_halve(ll);
+    set_ith_bit(result, i);
+    i++;
+    stream_finished_bits(stream, result, i);
+  }
+  set_ith_bit(result, i);
+}
+
 limb_dlist_t* collatz_decode(limb_dlist_t* ll) {
   limb_dlist_t* result = new_limb_list();
   size_t bit_length = get_bit_length(ll);
@@ -54,12 +134,63 @@ limb_dlist_t* collatz_decode(limb_dlist_t* ll) {
   }
 
   for (size_t i = bit_length - 2; i != __SIZE_MAX__; i--) {
-    left_shift(result);
-    
-    if (get_ith_bit(ll, i) != 0) {
-      minus_one(result);
-      divide_by_three(result);
+    size_t steps = collatz_decode_fixed(result, ll, i);
+    if (steps != 0) {
+      // The loop decrement accounts for the last step
+      i -= steps - 1u;
+      continue;
     }
+
+    // Runs of equal bits are undone together as far as the base allows
+    bool bit = get_ith_bit(ll, i) != 0;
+    size_t max_run = bit && LIMB_RADIX_THREES < LIMB_RADIX_TWOS ? LIMB_RADIX_THREES : LIMB_RADIX_TWOS;
+    size_t k = 1;
+    while (k < max_run && k <= i && (get_ith_bit(ll, i - k) != 0) == bit) k++;
+
+    if (bit) {
+      // (2 x - 1) / 3 in a single sweep, or 2^k floor(x / 3^k) + 2^k - 1
+      if (k == 1) fused_double_decrement_divide_by_three(result);
+      else fused_inverse_odd_steps(result, k);
+    }
+    else {
+      if (k == 1) left_shift(result);
+      else left_shift_by(result, k);
+    }
+    // The loop decrement accounts for the last step
+    i -= k - 1u;
   }
   return result;
 }
+
+limb_dlist_t* collatz_decode_pow2(limb_dlist_t* ll) {
+  limb_dlist_t* result = new_limb_list();
+  collatz_decode_pow2_into(result, ll);
+  return result;
+}
+
+void collatz_decode_pow2_into(limb_dlist_t* result, limb_dlist_t* ll) {
+  size_t bit_length = get_bit_length(ll);
+
+  result->length = 0;
+  insert_at_tail(result, 1);
+
+  // There does not exist a collatz encoding for 0
+  // so we must check if its equal to zero
+  canonicalize(ll);
+  if (ll->length == 0) {
+    return;
+  }
+
+  // Zero bits only double the result so batch them into one shift
+  size_t zeros = 0;
+  for (size_t i = bit_length - 2; i != __SIZE_MAX__; i--) {
+    if (get_ith_bit(ll, i) == 0) {
+      zeros++;
+      continue;
+    }
+    pow2_left_shift_by(result, zeros);
+    zeros = 0;
+    pow2_fused_double_decrement_divide_by_three(result);
+  }
+  pow2_left_shift_by(result, zeros);
+}
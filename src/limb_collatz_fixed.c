@@ -0,0 +1,158 @@
+#include <string.h>
+
+#include "collatz_tuning.h"
+#include "limb_collatz_fixed.h"
+#include "limb_radix_common.h"
+#include "limb_radix_custom.h"
+#include "limb_radix_pow2.h"
+
+// Every limb sum in these kernels is below 2 * LIMB_BASE, so the
+// carry is a compare instead of a division by the base
+#define CARRY_OF(SUM) ((SUM) >= LIMB_BASE)
+
+// While the top limb is below half the base, both x -> 2x and
+// x -> (3x + 1) / 2 still fit in the same number of limbs
+#define FITS_CLASS(X, N) ((X)[(N) - 1] < LIMB_DIVIDE_BY_TWO)
+
+#define DEFINE_ENCODE_FIXED(N) \
+static size_t encode_fixed_##N(limb_t* x, limb_dlist_t* result, size_t bit_index, limb_t stop_below, size_t max_steps) { \
+  size_t steps = 0; \
+  while (steps < max_steps && FITS_CLASS(x, N)) { \
+    limb_t upper = 0; \
+    for (size_t i = 1; i < (N); i++) upper |= x[i]; \
+    if (upper == 0 && x[0] < stop_below) break; \
+    \
+    if (x[0] % 2u == 0) { \
+      /* x / 2 */ \
+      for (size_t i = 0; i + 1 < (N); i++) { \
+        x[i] = (x[i] / 2u) + (x[i + 1] % 2u) * LIMB_DIVIDE_BY_TWO; \
+      } \
+      x[(N) - 1] /= 2u; \
+    } \
+    else { \
+      /* x + (x + 1) / 2 where the + 1 is the initial carry */ \
+      limb_t carry = 1; \
+      for (size_t i = 0; i < (N); i++) { \
+        limb_t half = (x[i] / 2u) + (i + 1 < (N) ? (x[i + 1] % 2u) * LIMB_DIVIDE_BY_TWO : 0); \
+        limb_t sum = x[i] + half + carry; \
+        carry = CARRY_OF(sum); \
+        x[i] = sum - carry * LIMB_BASE; \
+      } \
+      set_ith_bit(result, bit_index + steps); \
+    } \
+    steps++; \
+  } \
+  return steps; \
+}
+
+#define DEFINE_DECODE_FIXED(N) \
+static size_t decode_fixed_##N(limb_t* x, limb_dlist_t* ll, size_t bit_index, size_t max_steps) { \
+  size_t steps = 0; \
+  while (steps < max_steps && steps <= bit_index && FITS_CLASS(x, N)) { \
+    /* 2 x */ \
+    limb_t carry = 0; \
+    for (size_t i = 0; i < (N); i++) { \
+      limb_t sum = (x[i] << 1u) + carry; \
+      carry = CARRY_OF(sum); \
+      x[i] = sum - carry * LIMB_BASE; \
+    } \
+    \
+    if (get_ith_bit(ll, bit_index - steps) != 0) { \
+      /* (2 x - 1) / 3, the doubled value is at least 2 so the borrow stops */ \
+      for (size_t i = 0; i < (N); i++) { \
+        if (x[i] != 0) { \
+          x[i]--; \
+          break; \
+        } \
+        x[i] = LIMB_MAX_VAL; \
+      } \
+      for (size_t i = 0; i + 1 < (N); i++) { \
+        x[i] = (x[i] / 3u) + (x[i + 1] % 3u) * LIMB_DIVIDE_BY_THREE; \
+      } \
+      x[(N) - 1] /= 3u; \
+    } \
+    steps++; \
+  } \
+  return steps; \
+}
+
+DEFINE_ENCODE_FIXED(1)
+DEFINE_ENCODE_FIXED(2)
+DEFINE_ENCODE_FIXED(4)
+DEFINE_ENCODE_FIXED(8)
+DEFINE_ENCODE_FIXED(16)
+
+DEFINE_DECODE_FIXED(1)
+DEFINE_DECODE_FIXED(2)
+DEFINE_DECODE_FIXED(4)
+DEFINE_DECODE_FIXED(8)
+DEFINE_DECODE_FIXED(16)
+
+// Smallest size class up to `max_limbs` that ll fits in with room
+// to grow, 0 if none
+static size_t size_class(limb_dlist_t* ll, size_t max_limbs) {
+  canonicalize(ll);
+  size_t needed = ll->length;
+  if (needed != 0 && LL_TAIL(ll) >= LIMB_DIVIDE_BY_TWO) needed++;
+
+  for (size_t n = 1; n <= max_limbs; n *= 2u) {
+    if (needed <= n) return n;
+  }
+  return 0;
+}
+
+static void load_class(limb_t* x, limb_dlist_t* ll) {
+  memset(x, 0, FIXED_MAX_LIMBS * sizeof(limb_t));
+  memcpy(x, ll->handle, ll->length * sizeof(limb_t));
+}
+
+static void store_class(limb_dlist_t* ll, limb_t* x, size_t n) {
+  pad_to_length(ll, n);
+  memcpy(ll->handle, x, n * sizeof(limb_t));
+  ll->length = n;
+  canonicalize(ll);
+}
+
+size_t collatz_encode_fixed(limb_dlist_t* ll, limb_dlist_t* result, size_t bit_index, limb_t stop_below) {
+  const collatz_tuning_t* tuning = get_collatz_tuning();
+  size_t n = size_class(ll, tuning->fixed_max_limbs);
+  if (n == 0) return 0;
+
+  limb_t x[FIXED_MAX_LIMBS];
+  load_class(x, ll);
+
+  size_t steps = 0;
+  switch (n) {
+    case 1: steps = encode_fixed_1(x, result, bit_index, stop_below, tuning->fixed_chunk_steps); break;
+    case 2: steps = encode_fixed_2(x, result, bit_index, stop_below, tuning->fixed_chunk_steps); break;
+    case 4: steps = encode_fixed_4(x, result, bit_index, stop_below, tuning->fixed_chunk_steps); break;
+    case 8: steps = encode_fixed_8(x, result, bit_index, stop_below, tuning->fixed_chunk_steps); break;
+    case 16: steps = encode_fixed_16(x, result, bit_index, stop_below, tuning->fixed_chunk_steps); break;
+  }
+
+  store_class(ll, x, n);
+  COUNT_RADIX_PASSES(steps);
+  return steps;
+}
+
+size_t collatz_decode_fixed(limb_dlist_t* result, limb_dlist_t* ll, size_t bit_index) {
+  const collatz_tuning_t* tuning = get_collatz_tuning();
+  size_t n = size_class(result, tuning->fixed_max_limbs);
+  if (n == 0) return 0;
+
+  limb_t x[FIXED_MAX_LIMBS];
+  load_class(x, result);
+
+  size_t steps = 0;
+  switch (n) {
+    case 1: steps = decode_fixed_1(x, ll, bit_index, tuning->fixed_chunk_steps); break;
+    case 2: steps = decode_fixed_2(x, ll, bit_index, tuning->fixed_chunk_steps); break;
+    case 4: steps = decode_fixed_4(x, ll, bit_index, tuning->fixed_chunk_steps); break;
+    case 8: steps = decode_fixed_8(x, ll, bit_index, tuning->fixed_chunk_steps); break;
+    case 16: steps = decode_fixed_16(x, ll, bit_index, tuning->fixed_chunk_steps); break;
+  }
+
+  store_class(result, x, n);
+  COUNT_RADIX_PASSES(steps);
+  return steps;
+}
@@ -1,7 +1,11 @@
 
+#define _GNU_SOURCE
+
 #include <assert.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/mman.h>
 
 #include "limb_dlist.h"
 
@@ -13,21 +17,74 @@
 
 #define max(a,b) ((a) > (b) ? (a) : (b))
 
+#define min(a,b) ((a) < (b) ? (a) : (b))
+
 #define IS_POWER_OF_TWO(N) (((N) & ((N) - 1u)) == 0u)
 
-limb_t* new_limb_handle(size_t container_size) {
-  limb_t* handle = (limb_t*) malloc(sizeof(limb_t) * container_size);
-  assert(handle != NULL && "oom: failed to allocate new limb memory");
-  return handle;
+// Copies of the tuning knobs so the hot paths only read a static.
+// Accessed atomically since a profile may be loaded while other
+// threads are already working on lists.
+static size_t tuned_initial_limbs = LL_INITIAL_SIZE;
+static size_t tuned_huge_page_threshold = LL_HUGE_PAGE_THRESHOLD;
+
+#define INITIAL_LIMBS() __atomic_load_n(&tuned_initial_limbs, __ATOMIC_RELAXED)
+
+void set_limb_list_tuning(size_t initial_limbs, size_t huge_page_threshold) {
+  __atomic_store_n(&tuned_initial_limbs, initial_limbs, __ATOMIC_RELAXED);
+  __atomic_store_n(&tuned_huge_page_threshold, huge_page_threshold, __ATOMIC_RELAXED);
+}
+
+bool is_huge_container(size_t container_size) {
+  return container_size * sizeof(limb_t) >= __atomic_load_n(&tuned_huge_page_threshold, __ATOMIC_RELAXED);
+}
+
+static limb_t* new_huge_handle(size_t size) {
+  // Over-reserve so the mapping can be trimmed to start on a huge page
+  size_t reserved = size + LL_HUGE_PAGE_SIZE;
+  unsigned char* map = mmap(NULL, reserved, PROT_READ | PROT_WRITE,
+    MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  assert(map != MAP_FAILED && "oom: failed to map new limb memory");
+
+  uintptr_t start = ((uintptr_t) map + LL_HUGE_PAGE_SIZE - 1u) & ~(LL_HUGE_PAGE_SIZE - 1u);
+  unsigned char* aligned = (unsigned char*) start;
+  size_t head = (size_t) (aligned - map);
+  if (head != 0) munmap(map, head);
+  munmap(aligned + size, reserved - head - size);
+
+  madvise(aligned, size, MADV_HUGEPAGE);
+  return (limb_t*) aligned;
+}
+
+limb_t* new_limb_handle(size_t container_size, bool is_huge) {
+  if (is_huge) {
+    return new_huge_handle(sizeof(limb_t) * container_size);
+  }
+
+  void* handle = NULL;
+  int err = posix_memalign(&handle, LL_ALIGNMENT, sizeof(limb_t) * container_size);
+  assert(err == 0 && handle != NULL && "oom: failed to allocate new limb memory");
+  (void) err;
+  return (limb_t*) handle;
+}
+
+void destroy_limb_handle(limb_t* handle, size_t container_size, bool is_huge) {
+  if (handle == NULL) return;
+  if (is_huge) {
+    munmap(handle, sizeof(limb_t) * container_size);
+    return;
+  }
+  free(handle);
 }
 
 limb_dlist_t* new_limb_list() {
   limb_dlist_t* ll = (limb_dlist_t*) malloc(sizeof(limb_dlist_t));
   assert(ll != NULL && "oom: failed to allocate new limb list");
   
+  size_t initial_limbs = INITIAL_LIMBS();
   ll->length = 0;
-  ll->container_size = LL_INITIAL_SIZE;
-  ll->handle = new_limb_handle(LL_INITIAL_SIZE);
+  ll->container_size = initial_limbs;
+  ll->is_huge = is_huge_container(initial_limbs);
+  ll->handle = new_limb_handle(initial_limbs, ll->is_huge);
   
   return ll;
 }
@@ -55,13 +112,37 @@ void remove_at_tail(limb_dlist_t* ll) {
 }
 
 void resize_limb_list(limb_dlist_t* ll, size_t container_size) {
-  limb_t* new_handle = realloc(ll->handle, container_size * sizeof(limb_t));
-  assert(new_handle != NULL 
-    && "oom: failed to re-allocate new limb memory");
   assert(IS_POWER_OF_TWO(container_size) 
     && "err: expected container_size to be a power of 2");
+
+  limb_t* new_handle;
+  bool is_huge = is_huge_container(container_size);
+  if (ll->is_huge && is_huge) {
+    // Remaps the existing pages instead of copying them, in place
+    // when the mapping can grow there
+    size_t old_size = ll->container_size * sizeof(limb_t);
+    size_t new_size = container_size * sizeof(limb_t);
+    new_handle = mremap(ll->handle, old_size, new_size, 0);
+    if (new_handle == MAP_FAILED) {
+      // Letting the kernel pick the new address could lose the huge
+      // page alignment, so move the pages into an aligned reservation
+      limb_t* target = new_huge_handle(new_size);
+      new_handle = mremap(ll->handle, old_size, new_size, MREMAP_MAYMOVE | MREMAP_FIXED, target);
+    }
+    assert(new_handle != MAP_FAILED
+      && "oom: failed to re-map limb memory");
+    madvise(new_handle, container_size * sizeof(limb_t), MADV_HUGEPAGE);
+  }
+  else {
+    // Only the limbs in use need to survive the resize
+    new_handle = new_limb_handle(container_size, is_huge);
+    memcpy(new_handle, ll->handle, min(ll->length, container_size) * sizeof(limb_t));
+    destroy_limb_handle(ll->handle, ll->container_size, ll->is_huge);
+  }
+
   ll->handle = new_handle;
   ll->container_size = container_size;
+  ll->is_huge = is_huge;
 }
 
 void grow_limb_list(limb_dlist_t* ll) {
@@ -75,7 +156,7 @@ void shrink_limb_list(limb_dlist_t* ll) {
 bool is_well_sized(limb_dlist_t* ll, size_t length) {
   bool does_fit = length <= ll->container_size;
   bool is_snug_fit = length > ll->container_size / 4;
-  bool is_small = length < LL_INITIAL_SIZE;
+  bool is_small = length < INITIAL_LIMBS();
 
   if (does_fit && is_snug_fit) return true;
   if (does_fit && is_small) return true;
@@ -91,7 +172,7 @@ void resize_limb_list_to_length(limb_dlist_t* ll, size_t length) {
     _length >>= 1;
     log2_len++;    
   }
-  size_t pow2_rounded_len = max(1 << log2_len, LL_INITIAL_SIZE);
+  size_t pow2_rounded_len = max((size_t) 1u << log2_len, INITIAL_LIMBS());
 
   resize_limb_list(ll, pow2_rounded_len);
   assert(is_well_sized(ll, length) 
@@ -102,16 +183,15 @@ void swap_limb_list(limb_dlist_t* a, limb_dlist_t* b) {
   swap(a->length, b->length);
   swap(a->container_size, b->container_size);
   swap(a->handle, b->handle);
+  swap(a->is_huge, b->is_huge);
 }
 
 void copy_limb_list(limb_dlist_t* dest, limb_dlist_t* src) {
   bool will_fit_data = dest->container_size >= src->length;
 
   if (!will_fit_data) {
-    // TODO: perf: small performance inefficiency since
-    // resize keeps the underlying data by copying
-    // the old data into a new buffer; however, we don't
-    // need the old data
+    // Drop the old data first so resize has nothing to copy
+    dest->length = 0;
     resize_limb_list_to_length(dest, src->length);
   }
 
@@ -120,7 +200,7 @@ void copy_limb_list(limb_dlist_t* dest, limb_dlist_t* src) {
 }
 
 void destroy_limb_list(limb_dlist_t* ll) {
-  free(ll->handle);
+  destroy_limb_handle(ll->handle, ll->container_size, ll->is_huge);
   ll->handle = NULL;
   ll->length = 0;
   ll->container_size = 0;
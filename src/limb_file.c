@@ -1,70 +1,80 @@
 #include <stdbool.h>
+#include <sys/stat.h>
 #include "limb_file.h"
 
+// Limbs to read first. A regular file is read whole in one block of
+// its remaining size, anything else starts small so that tiny inputs
+// never grow the container past what they need
+static size_t first_block_limbs(FILE *file) {
+  struct stat st;
+  if (fstat(fileno(file), &st) != 0 || !S_ISREG(st.st_mode)) return LL_INITIAL_SIZE;
+
+  long offset = ftell(file);
+  if (offset < 0 || st.st_size < offset) return LL_INITIAL_SIZE;
+  // One limb more than the file holds so the read ends at eof
+  return (size_t) (st.st_size - offset) / sizeof(limb_t) + 1u;
+}
+
 size_t read_file(limb_dlist_t* ll, FILE *file) {
-  limb_t limb;
   size_t bytes_read = 0;
-  size_t units_read;
-  fpos_t pos;
+  size_t base = ll->length;
+  size_t block_limbs = first_block_limbs(file);
 
+  // Whole blocks are read straight into the container, so the
+  // trailing partial limb is simply whatever is left at eof and
+  // the file never has to be seeked
   while (true) {
-    fgetpos(file, &pos);
-    units_read = fread(&limb, sizeof(limb), 1, file);
-    bytes_read += units_read * sizeof(limb_t);
-    if (units_read != 1) {
-      if (feof(file)) {
-        // Rewind back to just b4 eof error and attempt to read bytes
-        fsetpos(file, &pos);
-
-        // Read last bytes
-        unsigned char mini_limb[sizeof(limb)] = {0};
-        size_t mini_limb_len = 0;
-
-        // Read byte by byte until we fail
-        while (fread(&mini_limb[mini_limb_len++], 1, 1, file) == 1);
-
-        // Last mini_limb is always the failed byte so it doesn't
-        // count as part of the length of the mini_limb
-        mini_limb_len--;
-
-        printf("info: read %zu eof bytes\n", mini_limb_len);
-
-        // Reconstruct limb from mini limb
-        limb = 0;
-        for (size_t i = 0; i < mini_limb_len; i++) {
-          printf("info: got byte %02x\n", mini_limb[i]);
-          limb <<= 8;
-          limb |= mini_limb[mini_limb_len - 1 - i];
-        }
-
-        printf("info: reconstructed limb: %016llx\n", limb);
-
-        bytes_read += mini_limb_len;
-        resize_limb_list_to_length(ll, ll->length + 1);
-        insert_at_tail(ll, limb);
-
-        break;
-      }
+    size_t full_limbs = bytes_read / sizeof(limb_t);
+    ll->length = base + full_limbs;
+    resize_limb_list_to_length(ll, ll->length + block_limbs + 1u);
+
+    unsigned char* dest = (unsigned char*) (ll->handle + base) + bytes_read;
+    size_t bytes_want = (full_limbs + block_limbs) * sizeof(limb_t) - bytes_read;
+    size_t bytes_block = fread(dest, 1, bytes_want, file);
+    bytes_read += bytes_block;
+
+    if (bytes_block != bytes_want) {
       if (ferror(file)) return __SIZE_MAX__;
+      break;
     }
 
-    resize_limb_list_to_length(ll, ll->length + 1);
-    insert_at_tail(ll, limb);
+    // Pipes double their blocks up to FILE_BLOCK_LIMBS
+    if (block_limbs < FILE_BLOCK_LIMBS) {
+      block_limbs = block_limbs * 2u < FILE_BLOCK_LIMBS ? block_limbs * 2u : FILE_BLOCK_LIMBS;
+    }
+  }
+
+  size_t full_limbs = bytes_read / sizeof(limb_t);
+  size_t mini_limb_len = bytes_read % sizeof(limb_t);
+  unsigned char* mini_limb = (unsigned char*) (ll->handle + base + full_limbs);
+
+  // Reconstruct limb from mini limb
+  limb_t limb = 0;
+  for (size_t i = 0; i < mini_limb_len; i++) {
+    limb <<= 8;
+    limb |= mini_limb[mini_limb_len - 1 - i];
   }
+
+  ll->length = base + full_limbs;
+  insert_at_tail(ll, limb);
   return bytes_read;
 }
 
 size_t write_file(limb_dlist_t* ll, FILE *file) {
+  return write_file_from(ll, 0, file);
+}
+
+size_t write_file_from(limb_dlist_t* ll, size_t start, FILE *file) {
   size_t bytes_write = 0;
-  size_t units_write;
 
   // We can't write nothing
-  if (ll->length == 0) return __SIZE_MAX__;
-  
-  for (size_t i = 0; i < ll->length - 1; i++) {
-    units_write = fwrite(&LL_INDEX(ll, i), sizeof(limb_t), 1, file);
+  if (ll->length == 0 || start >= ll->length) return __SIZE_MAX__;
+
+  for (size_t i = start; i < ll->length - 1; i += FILE_BLOCK_LIMBS) {
+    size_t units_want = ll->length - 1 - i < FILE_BLOCK_LIMBS ? ll->length - 1 - i : FILE_BLOCK_LIMBS;
+    size_t units_write = fwrite(&LL_INDEX(ll, i), sizeof(limb_t), units_want, file);
     bytes_write += units_write * sizeof(limb_t);
-    if (units_write != 1) {
+    if (units_write != units_want) {
       return __SIZE_MAX__;
     }
   }
@@ -72,15 +82,12 @@ size_t write_file(limb_dlist_t* ll, FILE *file) {
   // Decompose into mini limbs
   limb_t limb = LL_TAIL(ll);
 
-  printf("info: got limb %016llx\n", limb);
-
   unsigned char mini_limb[sizeof(limb_t)] = {0};
   size_t mini_limb_len = sizeof(limb_t);
 
   for (size_t i = 0; i < sizeof(limb_t); i++) {
     mini_limb[i] = limb & 0xff;
     limb >>= 8;
-    printf("info: got byte %02x\n", mini_limb[i]);
   }
 
   // Chop off the most significant bytes equal to zero
@@ -89,13 +96,11 @@ size_t write_file(limb_dlist_t* ll, FILE *file) {
     mini_limb_len--;
   }
 
-  printf("info: wrote %zu eof bytes\n", mini_limb_len);
-
-  // Write the mini-limbs byte by byte
-  for (size_t i = 0; i < mini_limb_len; i++) {
-    if (fwrite(&mini_limb[i], 1, 1, file) != 1) break;
-    bytes_write++;
+  // Write the mini-limbs in one go
+  if (fwrite(mini_limb, 1, mini_limb_len, file) != mini_limb_len) {
+    return __SIZE_MAX__;
   }
+  bytes_write += mini_limb_len;
 
   return bytes_write;
 }
@@ -4,6 +4,10 @@
 #include "limb_radix_pow2.h"
 
 void to_radix_pow2(limb_dlist_t* dest, limb_dlist_t* src) {
+  to_radix_pow2_streamed(dest, src, NULL);
+}
+
+void to_radix_pow2_streamed(limb_dlist_t* dest, limb_dlist_t* src, limb_stream_t* stream) {
   size_t src_bit_len = get_bit_length(src);
   
   // TODO: perf: create clear command so we dont call
@@ -18,6 +22,7 @@ void to_radix_pow2(limb_dlist_t* dest, limb_dlist_t* src) {
     }
     if (is_eq_one(src)) break;
     right_shift(src);
+    stream_finished_bits(stream, dest, i + 1);
   }
 }
 void to_radix_custom(limb_dlist_t* dest, limb_dlist_t* src) {
@@ -1,4 +1,6 @@
 
+#include <assert.h>
+
 #include "limb_radix_common.h"
 #include "limb_radix_custom.h"
 
@@ -27,8 +29,13 @@ while (0)
 
 #define max(a,b) ((a) > (b) ? (a) : (b))
 
+#ifdef COLLATZ_COUNT_PASSES
+_Thread_local size_t custom_radix_passes = 0;
+#endif
+
 
 void add(limb_dlist_t* a, limb_dlist_t* b) {
+  COUNT_RADIX_PASSES(1);
   canonicalize(a);
   canonicalize(b);
 
@@ -41,24 +48,28 @@ void add(limb_dlist_t* a, limb_dlist_t* b) {
 }
 
 void plus_one(limb_dlist_t* ll) {
+  COUNT_RADIX_PASSES(1);
   guard_against_overflow(ll);
   
   FOR_EACH_CARRY_PROPAGATE(ll, LL_INDEX(ll, i) + (i == 0));
 }
 
 void minus_one(limb_dlist_t* ll) {
+  COUNT_RADIX_PASSES(1);
   guard_against_overflow(ll);
   
   FOR_EACH_CARRY_PROPAGATE(ll, LL_INDEX(ll, i) + LIMB_MAX_VAL);
 }
 
 void left_shift(limb_dlist_t* ll) {
+  COUNT_RADIX_PASSES(1);
   guard_against_overflow(ll);
   
   FOR_EACH_CARRY_PROPAGATE(ll, LL_INDEX(ll, i) << 1u);
 }
 
 void right_shift(limb_dlist_t* ll) {
+  COUNT_RADIX_PASSES(1);
   // Ensures most significant limb is 0 so we dont have to do a check for the (i+1)-th index
   canonicalize(ll);
   guard_against_overflow(ll);
@@ -71,6 +82,7 @@ void right_shift(limb_dlist_t* ll) {
 }
 
 void divide_by_three(limb_dlist_t* ll) {
+  COUNT_RADIX_PASSES(1);
   // Ensures most significant limb is 0 so we dont have to do a check for the (i+1)-th index
   canonicalize(ll);
   guard_against_overflow(ll);
@@ -87,6 +99,7 @@ void divide_by_three(limb_dlist_t* ll) {
 }
 
 void multiply_by_three(limb_dlist_t* ll) {
+  COUNT_RADIX_PASSES(1);
   // Ensure most significant limb is 0
   canonicalize(ll);
   guard_against_overflow(ll);
@@ -112,6 +125,7 @@ void multiply_by_three(limb_dlist_t* ll) {
 }
 
 void multiply_by_three_and_increment(limb_dlist_t* ll) {
+  COUNT_RADIX_PASSES(1);
   guard_against_overflow(ll);
 
   limb_t carry = 1;
@@ -134,6 +148,7 @@ void multiply_by_three_and_increment(limb_dlist_t* ll) {
 }
 
 void divide_by_three_optim(limb_dlist_t* ll, limb_dlist_t* buffer) {
+  COUNT_RADIX_PASSES(1);
   // Ensures most significant limb is 0 so we dont have to do a check for the (i+1)-th index
   canonicalize(ll);
   guard_against_overflow(ll);
@@ -166,6 +181,7 @@ void divide_by_three_optim(limb_dlist_t* ll, limb_dlist_t* buffer) {
 }
 
 void fused_increment_divide_by_two(limb_dlist_t* ll) {
+  COUNT_RADIX_PASSES(1);
   // Ensures most significant limb is 0 so we dont have to do a check for the (i+1)-th index
   canonicalize(ll);
   guard_against_overflow(ll);
@@ -174,3 +190,199 @@ void fused_increment_divide_by_two(limb_dlist_t* ll) {
   ll->length--;
   FOR_EACH_CARRY_PROPAGATE(ll, (LL_INDEX(ll, i) / 2u) + (LL_INDEX(ll, i + 1) % 2u) * LIMB_DIVIDE_BY_TWO + (i == 0));
 }
+
+void fused_multiply_by_three_increment_halve(limb_dlist_t* ll) {
+  COUNT_RADIX_PASSES(1);
+  // Ensures most significant limb is 0 so we dont have to do a check for the (i+1)-th index
+  canonicalize(ll);
+  guard_against_overflow(ll);
+
+  // (3x + 1) / 2 = x + (x + 1) / 2 for odd x, in one sweep with no
+  // scratch list. Each limb of (x + 1) / 2 is at most b so every sum
+  // stays below 2b and the carry is at most 1.
+  limb_t carry = 0;
+  for (size_t i = 0; i < ll->length - 1; i++) {
+    limb_t half = (LL_INDEX(ll, i) / 2u) + (LL_INDEX(ll, i + 1) % 2u) * LIMB_DIVIDE_BY_TWO + (i == 0);
+    limb_t sum = LL_INDEX(ll, i) + half + carry;
+    carry = sum >= LIMB_BASE;
+    LL_INDEX(ll, i) = sum - carry * LIMB_BASE;
+  }
+  LL_TAIL(ll) = carry;
+}
+
+// Limb of 2x - 1 given limb x, carrying the doubling and the
+// decrement borrow over to the next limb
+static inline limb_t double_decrement_limb(limb_t x, limb_t* carry, limb_t* borrow) {
+  limb_t doubled = (x << 1u) + *carry;
+  *carry = doubled >= LIMB_BASE;
+  doubled -= *carry * LIMB_BASE;
+
+  bool is_borrowed = *borrow != 0 && doubled == 0;
+  limb_t limb = is_borrowed ? LIMB_MAX_VAL : doubled - *borrow;
+  *borrow = is_borrowed;
+  return limb;
+}
+
+void fused_double_decrement_divide_by_three(limb_dlist_t* ll) {
+  COUNT_RADIX_PASSES(1);
+  // Ensures most significant limb is 0 so that 2x fits in place
+  canonicalize(ll);
+  guard_against_overflow(ll);
+
+  // (2x - 1) / 3 in one ascending sweep. Limb i of the quotient
+  // needs limb i + 1 of 2x - 1 for its remainder, so the dividend is
+  // computed one limb ahead of the quotient. Doubling carries and the
+  // decrement borrows are tracked separately so nothing exceeds 2b.
+  limb_t carry = 0;
+  limb_t borrow = 1;
+
+  limb_t dividend = double_decrement_limb(LL_INDEX(ll, 0), &carry, &borrow);
+  for (size_t i = 0; i < ll->length - 1; i++) {
+    limb_t next_dividend = double_decrement_limb(LL_INDEX(ll, i + 1), &carry, &borrow);
+    LL_INDEX(ll, i) = (dividend / 3u) + (next_dividend % 3u) * LIMB_DIVIDE_BY_THREE;
+    dividend = next_dividend;
+  }
+  LL_TAIL(ll) = dividend / 3u;
+
+  canonicalize(ll);
+}
+
+// Kernels for runs of k steps are generated for every k so that the
+// divisions by 2^k, 3^k and the base over them are by constants
+#define DEFINE_RUN_KERNELS(K) \
+static void right_shift_by_##K(limb_dlist_t* ll) { \
+  for (size_t i = 0; i < ll->length - 1; i++) { \
+    LL_INDEX(ll, i) = (LL_INDEX(ll, i) / LIMB_POW2(K)) + (LL_INDEX(ll, i + 1) % LIMB_POW2(K)) * LIMB_DIVIDE_BY_POW2(K); \
+  } \
+} \
+\
+static void divide_by_three_pow_##K(limb_dlist_t* ll) { \
+  for (size_t i = 0; i < ll->length - 1; i++) { \
+    LL_INDEX(ll, i) = (LL_INDEX(ll, i) / LIMB_POW3(K)) + (LL_INDEX(ll, i + 1) % LIMB_POW3(K)) * LIMB_DIVIDE_BY_POW3(K); \
+  } \
+} \
+\
+static void left_shift_by_##K(limb_dlist_t* ll) { \
+  limb_t carry = 0; \
+  for (size_t i = 0; i < ll->length; i++) { \
+    MULTIPLY_DIGIT(LL_INDEX(ll, i), LL_INDEX(ll, i), LIMB_POW2(K), LIMB_DIVIDE_BY_POW2(K), carry); \
+  } \
+} \
+\
+static void odd_steps_##K(limb_dlist_t* ll) { \
+  limb_t carry = LIMB_POW3(K) - 1u; \
+  for (size_t i = 0; i < ll->length - 1; i++) { \
+    limb_t half = (LL_INDEX(ll, i) / LIMB_POW2(K)) + (LL_INDEX(ll, i + 1) % LIMB_POW2(K)) * LIMB_DIVIDE_BY_POW2(K); \
+    MULTIPLY_DIGIT(LL_INDEX(ll, i), half, LIMB_POW3(K), LIMB_DIVIDE_BY_POW3(K), carry); \
+  } \
+  LL_TAIL(ll) = carry; \
+} \
+\
+static void inverse_odd_steps_##K(limb_dlist_t* ll) { \
+  limb_t carry = LIMB_POW2(K) - 1u; \
+  for (size_t i = 0; i < ll->length - 1; i++) { \
+    limb_t third = (LL_INDEX(ll, i) / LIMB_POW3(K)) + (LL_INDEX(ll, i + 1) % LIMB_POW3(K)) * LIMB_DIVIDE_BY_POW3(K); \
+    MULTIPLY_DIGIT(LL_INDEX(ll, i), third, LIMB_POW2(K), LIMB_DIVIDE_BY_POW2(K), carry); \
+  } \
+  LL_TAIL(ll) = carry; \
+}
+
+// OUT = DIGIT * M + CARRY split as in multiply_by_three so nothing
+// overflows: DIGIT = u (b / M) + r gives DIGIT * M = u b + r M where
+// r M < b. The carry stays at most M so every sum is at most b.
+#define MULTIPLY_DIGIT(OUT, DIGIT, M, BASE_OVER_M, CARRY) do { \
+  limb_t _digit = (DIGIT); \
+  limb_t _u = _digit / (BASE_OVER_M); \
+  limb_t _sum = (_digit - _u * (BASE_OVER_M)) * (M) + (CARRY); \
+  limb_t _overflow = _sum >= LIMB_BASE; \
+  (OUT) = _sum - _overflow * LIMB_BASE; \
+  (CARRY) = _u + _overflow; \
+} while (0)
+
+DEFINE_RUN_KERNELS(1)
+DEFINE_RUN_KERNELS(2)
+DEFINE_RUN_KERNELS(3)
+DEFINE_RUN_KERNELS(4)
+DEFINE_RUN_KERNELS(5)
+DEFINE_RUN_KERNELS(6)
+DEFINE_RUN_KERNELS(7)
+DEFINE_RUN_KERNELS(8)
+
+#define DISPATCH_RUN_KERNEL(NAME, K, LL) do { \
+  switch (K) { \
+    case 1: NAME##_1(LL); break; \
+    case 2: NAME##_2(LL); break; \
+    case 3: NAME##_3(LL); break; \
+    case 4: NAME##_4(LL); break; \
+    case 5: NAME##_5(LL); break; \
+    case 6: NAME##_6(LL); break; \
+    case 7: NAME##_7(LL); break; \
+    case 8: NAME##_8(LL); break; \
+  } \
+} while (0)
+
+void right_shift_by(limb_dlist_t* ll, size_t k) {
+  assert(k >= 1u && k <= LIMB_RADIX_TWOS && "err: base is not divisible by 2^k");
+  COUNT_RADIX_PASSES(1);
+
+  // Ensures most significant limb is 0 so we dont have to do a check for the (i+1)-th index
+  canonicalize(ll);
+  guard_against_overflow(ll);
+  DISPATCH_RUN_KERNEL(right_shift_by, k, ll);
+}
+
+void divide_by_three_pow(limb_dlist_t* ll, size_t k) {
+  assert(k >= 1u && k <= LIMB_RADIX_THREES && "err: base is not divisible by 3^k");
+  COUNT_RADIX_PASSES(1);
+
+  // Ensures most significant limb is 0 so we dont have to do a check for the (i+1)-th index
+  canonicalize(ll);
+  guard_against_overflow(ll);
+  DISPATCH_RUN_KERNEL(divide_by_three_pow, k, ll);
+}
+
+void left_shift_by(limb_dlist_t* ll, size_t k) {
+  assert(k >= 1u && k <= LIMB_RADIX_TWOS && "err: base is not divisible by 2^k");
+  COUNT_RADIX_PASSES(1);
+
+  // Ensures most significant limb is 0 so there is room for the carry
+  canonicalize(ll);
+  guard_against_overflow(ll);
+  DISPATCH_RUN_KERNEL(left_shift_by, k, ll);
+}
+
+void fused_odd_steps(limb_dlist_t* ll, size_t k) {
+  assert(k >= 1u && k <= LIMB_RADIX_TWOS && k <= LIMB_RADIX_THREES
+    && "err: base is not divisible by 2^k 3^k");
+  COUNT_RADIX_PASSES(1);
+
+  // Ensures most significant limb is 0 so there is room for the carry
+  canonicalize(ll);
+  guard_against_overflow(ll);
+  DISPATCH_RUN_KERNEL(odd_steps, k, ll);
+}
+
+void fused_inverse_odd_steps(limb_dlist_t* ll, size_t k) {
+  assert(k >= 1u && k <= LIMB_RADIX_TWOS && k <= LIMB_RADIX_THREES
+    && "err: base is not divisible by 2^k 3^k");
+  COUNT_RADIX_PASSES(1);
+
+  // Ensures most significant limb is 0 so we dont have to do a check for the (i+1)-th index
+  canonicalize(ll);
+  guard_against_overflow(ll);
+  DISPATCH_RUN_KERNEL(inverse_odd_steps, k, ll);
+  canonicalize(ll);
+}
+
+size_t even_run_length(limb_dlist_t* ll) {
+  // The base is divisible by 2^a so x = x_0 mod 2^a
+  limb_t low = LL_HEAD(ll) % LIMB_POW2(LIMB_RADIX_TWOS);
+  return low == 0 ? LIMB_RADIX_TWOS : (size_t) __builtin_ctzll(low);
+}
+
+size_t odd_run_length(limb_dlist_t* ll) {
+  // x stays odd for as many (3x + 1) / 2 steps as 2 divides x + 1
+  limb_t low = (LL_HEAD(ll) + 1u) % LIMB_POW2(LIMB_RADIX_TWOS);
+  size_t run = low == 0 ? LIMB_RADIX_TWOS : (size_t) __builtin_ctzll(low);
+  return run < LIMB_RADIX_THREES ? run : LIMB_RADIX_THREES;
+}
@@ -1,6 +1,14 @@
+#include <string.h>
+
 #include "limb_radix_common.h"
 #include "limb_radix_pow2.h"
 
+// 3 * INVERSE_OF_THREE = 1 mod 2^64
+#define INVERSE_OF_THREE 0xaaaaaaaaaaaaaaabull
+// q * 3 overflows a limb once q > (2^64 - 1) / 3 and twice once q > 2 (2^64 - 1) / 3
+#define ONE_THIRD_OF_MAX 0x5555555555555555ull
+#define TWO_THIRDS_OF_MAX 0xaaaaaaaaaaaaaaaaull
+
 void set_ith_bit(limb_dlist_t* ll, size_t bit_index) {
     size_t desired_limb = bit_index / LIMB_CONTAINER_BIT_LENGTH;
     size_t desired_bit = bit_index % LIMB_CONTAINER_BIT_LENGTH;
@@ -35,3 +43,131 @@ size_t get_bit_length(limb_dlist_t* ll) {
   return available_bits + used_bits - LIMB_CONTAINER_BIT_LENGTH;
 }
 
+
+void append_bits(limb_dlist_t* ll, size_t bit_index, const limb_t* bits, size_t bit_offset, size_t bit_length) {
+  if (bit_length == 0) return;
+
+  size_t end = bit_index + bit_length;
+  pad_to_length(ll, (end + LIMB_CONTAINER_BIT_LENGTH - 1u) / LIMB_CONTAINER_BIT_LENGTH);
+
+  for (size_t done = 0; done < bit_length; done += LIMB_CONTAINER_BIT_LENGTH) {
+    size_t src = bit_offset + done;
+    size_t src_limb = src / LIMB_CONTAINER_BIT_LENGTH;
+    size_t src_bit = src % LIMB_CONTAINER_BIT_LENGTH;
+
+    // Gather the next 64 bits which may straddle two source limbs
+    limb_t word = bits[src_limb] >> src_bit;
+    if (src_bit != 0) word |= bits[src_limb + 1] << (LIMB_CONTAINER_BIT_LENGTH - src_bit);
+
+    size_t chunk = bit_length - done;
+    if (chunk < LIMB_CONTAINER_BIT_LENGTH) word &= ((limb_t) 1u << chunk) - 1u;
+
+    // Scatter them which may also straddle two destination limbs
+    size_t dest = bit_index + done;
+    size_t dest_limb = dest / LIMB_CONTAINER_BIT_LENGTH;
+    size_t dest_bit = dest % LIMB_CONTAINER_BIT_LENGTH;
+
+    LL_INDEX(ll, dest_limb) |= word << dest_bit;
+    if (dest_bit != 0 && dest_limb + 1 < ll->length) {
+      LL_INDEX(ll, dest_limb + 1) |= word >> (LIMB_CONTAINER_BIT_LENGTH - dest_bit);
+    }
+  }
+}
+
+size_t pow2_count_trailing_zeros(limb_dlist_t* ll) {
+  for (size_t i = 0; i < ll->length; i++) {
+    if (LL_INDEX(ll, i) != 0) {
+      return i * LIMB_CONTAINER_BIT_LENGTH + (size_t) __builtin_ctzll(LL_INDEX(ll, i));
+    }
+  }
+  return ll->length * LIMB_CONTAINER_BIT_LENGTH;
+}
+
+void pow2_right_shift_by(limb_dlist_t* ll, size_t bits) {
+  size_t limbs = bits / LIMB_CONTAINER_BIT_LENGTH;
+  size_t shift = bits % LIMB_CONTAINER_BIT_LENGTH;
+
+  if (limbs >= ll->length) {
+    ll->length = 0;
+    return;
+  }
+
+  size_t length = ll->length - limbs;
+  if (shift == 0) {
+    memmove(ll->handle, ll->handle + limbs, length * sizeof(limb_t));
+  }
+  else {
+    for (size_t i = 0; i < length - 1; i++) {
+      LL_INDEX(ll, i) = (LL_INDEX(ll, i + limbs) >> shift)
+        | (LL_INDEX(ll, i + limbs + 1) << (LIMB_CONTAINER_BIT_LENGTH - shift));
+    }
+    LL_INDEX(ll, length - 1) = LL_TAIL(ll) >> shift;
+  }
+  ll->length = length;
+  canonicalize(ll);
+}
+
+void pow2_fused_multiply_by_three_increment_halve(limb_dlist_t* ll) {
+  // (3x + 1) / 2 = x + (x >> 1) + 1 when x is odd, which needs at most
+  // one more bit so a zero tail limb is enough room for the carry
+  canonicalize(ll);
+  guard_against_overflow(ll);
+
+  limb_t carry = 1;
+  for (size_t i = 0; i < ll->length - 1; i++) {
+    limb_t half = (LL_INDEX(ll, i) >> 1u) | (LL_INDEX(ll, i + 1) << (LIMB_CONTAINER_BIT_LENGTH - 1u));
+    wide_limb_t sum = (wide_limb_t) LL_INDEX(ll, i) + half + carry;
+    LL_INDEX(ll, i) = (limb_t) sum;
+    carry = (limb_t) (sum >> LIMB_CONTAINER_BIT_LENGTH);
+  }
+  LL_TAIL(ll) = carry;
+}
+
+void pow2_left_shift_by(limb_dlist_t* ll, size_t bits) {
+  if (bits == 0 || ll->length == 0) return;
+
+  size_t limbs = bits / LIMB_CONTAINER_BIT_LENGTH;
+  size_t shift = bits % LIMB_CONTAINER_BIT_LENGTH;
+  size_t length = ll->length;
+
+  // One extra limb to catch the bits shifted out of the tail
+  resize_limb_list_to_length(ll, length + limbs + 1u);
+  ll->length = length + limbs + 1u;
+  LL_TAIL(ll) = 0;
+
+  if (shift == 0) {
+    memmove(ll->handle + limbs, ll->handle, length * sizeof(limb_t));
+  }
+  else {
+    for (size_t i = length; i != 0; i--) {
+      LL_INDEX(ll, i + limbs) |= LL_INDEX(ll, i - 1) >> (LIMB_CONTAINER_BIT_LENGTH - shift);
+      LL_INDEX(ll, i - 1 + limbs) = LL_INDEX(ll, i - 1) << shift;
+    }
+  }
+  memset(ll->handle, 0, limbs * sizeof(limb_t));
+  canonicalize(ll);
+}
+
+void pow2_fused_double_decrement_divide_by_three(limb_dlist_t* ll) {
+  // (2x - 1) / 3 < x so the result always fits in place. Exact division
+  // is done low to high: each quotient limb is (limb - borrow) * 3^-1 and
+  // the borrow into the next limb is however many times q * 3 overflowed.
+  // The initial borrow of 1 takes care of the decrement for free.
+  limb_t borrow = 1;
+  limb_t shifted_in = 0;
+
+  for (size_t i = 0; i < ll->length; i++) {
+    limb_t limb = LL_INDEX(ll, i);
+    limb_t doubled = (limb << 1u) | shifted_in;
+    shifted_in = limb >> (LIMB_CONTAINER_BIT_LENGTH - 1u);
+
+    limb_t difference = doubled - borrow;
+    limb_t quotient = difference * INVERSE_OF_THREE;
+    LL_INDEX(ll, i) = quotient;
+
+    borrow = (limb_t) (doubled < borrow)
+      + (limb_t) (quotient > ONE_THIRD_OF_MAX)
+      + (limb_t) (quotient > TWO_THIRDS_OF_MAX);
+  }
+  canonicalize(ll);
+}
@@ -0,0 +1,110 @@
+#include <assert.h>
+#include <string.h>
+
+#include "limb_file.h"
+#include "limb_stream.h"
+
+#define min(a,b) ((a) < (b) ? (a) : (b))
+
+static void* stream_writer_main(void* arg) {
+  limb_stream_t* stream = (limb_stream_t*) arg;
+
+  pthread_mutex_lock(&stream->lock);
+  while (true) {
+    while (stream->length == 0 && !stream->is_done) {
+      pthread_cond_wait(&stream->not_empty, &stream->lock);
+    }
+    if (stream->length == 0) break;
+
+    // Write outside of the lock so the producer can keep filling blocks
+    size_t index = stream->head;
+    size_t length = stream->block_lengths[index];
+    pthread_mutex_unlock(&stream->lock);
+
+    limb_t* block = stream->blocks + index * STREAM_BLOCK_LIMBS;
+    size_t units_write = fwrite(block, sizeof(limb_t), length, stream->file);
+
+    pthread_mutex_lock(&stream->lock);
+    stream->bytes_write += units_write * sizeof(limb_t);
+    if (units_write != length) stream->has_failed = true;
+    stream->head = (stream->head + 1u) % STREAM_RING_BLOCKS;
+    stream->length--;
+    pthread_cond_signal(&stream->not_full);
+  }
+  pthread_mutex_unlock(&stream->lock);
+  return NULL;
+}
+
+limb_stream_t* new_limb_stream(FILE *file) {
+  limb_stream_t* stream = (limb_stream_t*) malloc(sizeof(limb_stream_t));
+  assert(stream != NULL && "oom: failed to allocate new stream");
+
+  stream->file = file;
+  stream->emitted = 0;
+  stream->next_flush_bit = STREAM_BLOCK_BITS;
+  stream->blocks_are_huge = is_huge_container(STREAM_BLOCK_LIMBS * STREAM_RING_BLOCKS);
+  stream->blocks = new_limb_handle(STREAM_BLOCK_LIMBS * STREAM_RING_BLOCKS, stream->blocks_are_huge);
+  stream->head = 0;
+  stream->length = 0;
+  stream->is_done = false;
+  stream->has_failed = false;
+  stream->bytes_write = 0;
+  pthread_mutex_init(&stream->lock, NULL);
+  pthread_cond_init(&stream->not_empty, NULL);
+  pthread_cond_init(&stream->not_full, NULL);
+
+  int err = pthread_create(&stream->thread, NULL, stream_writer_main, stream);
+  assert(err == 0 && "err: failed to start stream writer");
+  (void) err;
+  return stream;
+}
+
+void stream_finished_limbs(limb_stream_t* stream, limb_dlist_t* ll, size_t finished_limbs) {
+  // Finished zero limbs past the tail are not materialized yet
+  finished_limbs = min(finished_limbs, ll->length);
+
+  // Only whole blocks are handed over, the remainder waits for more limbs
+  while (finished_limbs >= stream->emitted + STREAM_BLOCK_LIMBS) {
+    pthread_mutex_lock(&stream->lock);
+    while (stream->length == STREAM_RING_BLOCKS) {
+      pthread_cond_wait(&stream->not_full, &stream->lock);
+    }
+    size_t index = (stream->head + stream->length) % STREAM_RING_BLOCKS;
+    pthread_mutex_unlock(&stream->lock);
+
+    // The slot is ours until it is published below
+    limb_t* block = stream->blocks + index * STREAM_BLOCK_LIMBS;
+    memcpy(block, ll->handle + stream->emitted, STREAM_BLOCK_LIMBS * sizeof(limb_t));
+
+    pthread_mutex_lock(&stream->lock);
+    stream->block_lengths[index] = STREAM_BLOCK_LIMBS;
+    stream->length++;
+    pthread_cond_signal(&stream->not_empty);
+    pthread_mutex_unlock(&stream->lock);
+
+    stream->emitted += STREAM_BLOCK_LIMBS;
+  }
+  stream->next_flush_bit = (stream->emitted + STREAM_BLOCK_LIMBS) * LIMB_CONTAINER_BIT_LENGTH;
+}
+
+size_t finish_limb_stream(limb_stream_t* stream, limb_dlist_t* ll) {
+  pthread_mutex_lock(&stream->lock);
+  stream->is_done = true;
+  pthread_cond_signal(&stream->not_empty);
+  pthread_mutex_unlock(&stream->lock);
+  pthread_join(stream->thread, NULL);
+
+  size_t bytes_write = stream->has_failed ? __SIZE_MAX__ : stream->bytes_write;
+  if (bytes_write != __SIZE_MAX__) {
+    canonicalize(ll);
+    size_t bytes_rest = write_file_from(ll, stream->emitted, stream->file);
+    bytes_write = bytes_rest == __SIZE_MAX__ ? __SIZE_MAX__ : bytes_write + bytes_rest;
+  }
+
+  destroy_limb_handle(stream->blocks, STREAM_BLOCK_LIMBS * STREAM_RING_BLOCKS, stream->blocks_are_huge);
+  pthread_mutex_destroy(&stream->lock);
+  pthread_cond_destroy(&stream->not_empty);
+  pthread_cond_destroy(&stream->not_full);
+  free(stream);
+  return bytes_write;
+}